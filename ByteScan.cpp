@@ -0,0 +1,133 @@
+/******************************************************************************
+ * ByteScan.cpp
+ *
+ * Fast search of a set of bytes (e.g. log delimiters) in a memory block.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "ByteScan.hpp"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace log_viewer {
+
+
+void ByteSet::Set(const std::string &_bytes)
+{
+	bytes.clear();
+	std::memset(table, 0, sizeof(table));
+
+	for(size_t i = 0; i < _bytes.size(); ++i)
+	{
+		if(!Contains(_bytes[i])) {
+			table[static_cast<unsigned char>(_bytes[i])] = true;
+			bytes += _bytes[i];
+		}
+	}
+}
+
+
+const char* ByteSet::FindFirst(const char *_begin, const char *_end) const
+{
+	if(bytes.empty() || _end <= _begin)
+		return nullptr;
+
+	if(bytes.size() == 1)
+		return static_cast<const char*>(std::memchr(_begin, bytes[0], size_t(_end - _begin)));
+
+	const char *p = _begin;
+
+#ifdef __SSE2__
+	if(bytes.size() <= maxVectorBytes)
+	{
+		__m128i needles[maxVectorBytes];
+		const size_t nNeedles = bytes.size();
+
+		for(size_t i = 0; i < nNeedles; ++i)
+			needles[i] = _mm_set1_epi8(bytes[i]);
+
+		for(; _end - p >= 16; p += 16)
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i match = _mm_cmpeq_epi8(chunk, needles[0]);
+
+			for(size_t i = 1; i < nNeedles; ++i)
+				match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, needles[i]));
+
+			const unsigned mask = unsigned(_mm_movemask_epi8(match));
+
+			if(mask != 0)
+				return p + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for(; p < _end; ++p)
+		if(Contains(*p))
+			return p;
+
+	return nullptr;
+}
+
+
+const char* ByteSet::FindLast(const char *_begin, const char *_end) const
+{
+	if(bytes.empty() || _end <= _begin)
+		return nullptr;
+
+#if defined(__GLIBC__)
+	if(bytes.size() == 1)
+		return static_cast<const char*>(memrchr(_begin, bytes[0], size_t(_end - _begin)));
+#endif
+
+	const char *p = _end;
+
+#ifdef __SSE2__
+	if(bytes.size() <= maxVectorBytes)
+	{
+		__m128i needles[maxVectorBytes];
+		const size_t nNeedles = bytes.size();
+
+		for(size_t i = 0; i < nNeedles; ++i)
+			needles[i] = _mm_set1_epi8(bytes[i]);
+
+		while(p - _begin >= 16)
+		{
+			p -= 16;
+
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i match = _mm_cmpeq_epi8(chunk, needles[0]);
+
+			for(size_t i = 1; i < nNeedles; ++i)
+				match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, needles[i]));
+
+			const unsigned mask = unsigned(_mm_movemask_epi8(match));
+
+			if(mask != 0)
+				return p + (31 - __builtin_clz(mask));
+		}
+	}
+#endif
+
+	while(p > _begin)
+	{
+		--p;
+		if(Contains(*p))
+			return p;
+	}
+
+	return nullptr;
+}
+
+
+} // log_viewer
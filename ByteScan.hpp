@@ -0,0 +1,54 @@
+/******************************************************************************
+ * ByteScan.hpp
+ *
+ * Fast search of a set of bytes (e.g. log delimiters) in a memory block.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef BYTE_SCAN_HPP
+#define BYTE_SCAN_HPP
+
+#include <string>
+
+
+namespace log_viewer {
+
+
+class ByteSet
+{
+	/** Up to maxVectorBytes bytes are matched 16 bytes at a time (SSE2);
+	 *  larger sets, or builds without SSE2, use a lookup table.
+	 */
+
+public:
+	static const size_t maxVectorBytes = 8;
+
+	ByteSet() { Set(""); }
+	explicit ByteSet(const std::string &_bytes) { Set(_bytes); }
+
+	void Set(const std::string &_bytes);
+	const std::string& Bytes() const { return bytes; }
+
+	bool Contains(char _c) const { return table[static_cast<unsigned char>(_c)]; }
+
+	// First byte of the set in [_begin, _end); nullptr if not found
+	const char* FindFirst(const char *_begin, const char *_end) const;
+
+	// Last byte of the set in [_begin, _end); nullptr if not found
+	const char* FindLast(const char *_begin, const char *_end) const;
+
+private:
+	std::string  bytes;
+	bool         table[256];
+};
+
+
+} // log_viewer
+
+
+#endif // BYTE_SCAN_HPP
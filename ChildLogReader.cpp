@@ -0,0 +1,229 @@
+/******************************************************************************
+ * ChildLogReader.cpp
+ *
+ * Input layer: run a command and read the logs it writes on its standard
+ * output and standard error, through pipes.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "ChildLogReader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+
+namespace log_viewer {
+
+
+void ChildLogReader::SetMaxLineSize(size_t _size, CutScan _scan)
+{
+	LogReader::SetMaxLineSize(_size, _scan);
+	out.SetMaxLineSize(_size, _scan);
+	err.SetMaxLineSize(_size, _scan);
+}
+
+
+#ifdef POSIX
+
+int ChildLogReader::Open(const std::string &)
+{
+	Close();
+
+	if(command.empty())
+		return err_openFailed;
+
+	// outPipe, errPipe: the logs; execPipe: errno of a failed exec, closed by a successful one
+	int outPipe[2], errPipe[2], execPipe[2];
+
+	if(pipe(outPipe) != 0)
+		return err_openFailed;
+
+	if(pipe(errPipe) != 0) {
+		close(outPipe[0]); close(outPipe[1]);
+		return err_openFailed;
+	}
+
+	if(pipe(execPipe) != 0) {
+		close(outPipe[0]); close(outPipe[1]);
+		close(errPipe[0]); close(errPipe[1]);
+		return err_openFailed;
+	}
+
+	fcntl(execPipe[1], F_SETFD, FD_CLOEXEC);
+
+	std::vector<char*> argv;
+	for(const std::string &arg : command)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	pid = fork();
+
+	if(pid == 0)
+	{
+		// Child
+		const int devNull = open("/dev/null", O_RDONLY);
+
+		if(devNull >= 0)
+			dup2(devNull, STDIN_FILENO);
+
+		dup2(outPipe[1], STDOUT_FILENO);
+		dup2(errPipe[1], STDERR_FILENO);
+
+		close(outPipe[0]); close(outPipe[1]);
+		close(errPipe[0]); close(errPipe[1]);
+		close(execPipe[0]);
+
+		execvp(argv[0], argv.data());
+
+		const int e = errno;
+		ssize_t n = write(execPipe[1], &e, sizeof(e));
+		(void)n;
+		_exit(127);
+	}
+
+	close(outPipe[1]);
+	close(errPipe[1]);
+	close(execPipe[1]);
+
+	int execErrno = 0;
+	ssize_t n = 0;
+
+	if(pid > 0) {
+		do {
+			n = read(execPipe[0], &execErrno, sizeof(execErrno));
+		} while(n < 0 && errno == EINTR);
+	}
+
+	close(execPipe[0]);
+
+	if(pid < 0 || n > 0)
+	{
+		close(outPipe[0]);
+		close(errPipe[0]);
+
+		if(pid > 0)
+			ExitStatus();		// reap the child
+		else
+			status = 127;
+
+		std::cerr << "logviewer: error: cannot run " << command[0] << ": "
+		          << std::strerror(pid < 0 ? errno : execErrno) << std::endl;
+
+		return err_openFailed;
+	}
+
+	fcntl(outPipe[0], F_SETFL, fcntl(outPipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(errPipe[0], F_SETFL, fcntl(errPipe[0], F_GETFL) | O_NONBLOCK);
+
+	out.Attach(outPipe[0]);
+	err.Attach(errPipe[0]);
+
+	stream = stream_stdout;
+
+	return 0;
+}
+
+
+void ChildLogReader::Close()
+{
+	// The command keeps running; its exit status can still be read
+	out.Close();
+	err.Close();
+}
+
+
+bool ChildLogReader::GetLine(std::string_view &_line)
+{
+	// The lines already received from both pipes come first; then each pipe is read
+	// once more: a busy standard output does not hold back the standard error
+	while(true)
+	{
+		if(out.GetLine(_line, false)) {
+			stream = stream_stdout;
+			truncated = out.Truncated();
+			return true;
+		}
+
+		if(err.GetLine(_line, false)) {
+			stream = stream_stderr;
+			truncated = err.Truncated();
+			return true;
+		}
+
+		const int nOut = out.Fill();
+		const int nErr = err.Fill();
+
+		if(nOut <= 0 && nErr <= 0)
+			return false;
+	}
+}
+
+
+std::vector<int> ChildLogReader::PollFds() const
+{
+	std::vector<int> fds = out.PollFds();
+	const std::vector<int> errFds = err.PollFds();
+
+	fds.insert(fds.end(), errFds.begin(), errFds.end());
+
+	return fds;
+}
+
+
+int ChildLogReader::ExitStatus()
+{
+	if(status >= 0 || pid <= 0)
+		return status < 0 ? 0 : status;
+
+	int st = 0;
+	pid_t r;
+
+	do {
+		r = waitpid(pid, &st, 0);
+	} while(r < 0 && errno == EINTR);
+
+	if(r != pid)
+		status = 0;
+	else if(WIFEXITED(st))
+		status = WEXITSTATUS(st);
+	else if(WIFSIGNALED(st))
+		status = 128 + WTERMSIG(st);
+	else
+		status = 0;
+
+	return status;
+}
+
+#else // no processes and pipes
+
+int ChildLogReader::Open(const std::string &)
+{
+	std::cerr << "logviewer: error: running a command is not available on this platform." << std::endl;
+	status = 1;
+	return err_openFailed;
+}
+
+void ChildLogReader::Close() {}
+bool ChildLogReader::GetLine(std::string_view &) { return false; }
+std::vector<int> ChildLogReader::PollFds() const { return std::vector<int>(); }
+int  ChildLogReader::ExitStatus() { return status < 0 ? 0 : status; }
+
+#endif // POSIX
+
+
+} // log_viewer
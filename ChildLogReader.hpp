@@ -0,0 +1,87 @@
+/******************************************************************************
+ * ChildLogReader.hpp
+ *
+ * Input layer: run a command and read the logs it writes on its standard
+ * output and standard error, through pipes.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef CHILD_LOG_READER_HPP
+#define CHILD_LOG_READER_HPP
+
+#include "LogReader.hpp"
+
+#include <string>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class ChildLogReader : public LogReader
+{
+	/** Open() starts the command, with its standard input on /dev/null (the
+	 *  keyboard is left to logviewer). Both pipes are read without blocking,
+	 *  in turns: GetLine() returns the complete lines read so far from the
+	 *  standard output, then those from the standard error, before reading
+	 *  each pipe once more. Stream() tells where the last line came from.
+	 *  Offsets count the bytes read from both pipes.
+	 */
+
+public:
+	// Where a line comes from
+	static const int stream_stdout = 0,
+	                 stream_stderr = 1;
+
+	explicit ChildLogReader(const std::vector<std::string> &_command) : command(_command) {}
+	~ChildLogReader() override             { Close(); }
+
+	int  Open(const std::string &_fileName) override;		// start the command; _fileName is ignored
+	void Close() override;
+	bool IsOpen() const override           { return pid > 0; }
+
+	bool GetLine(std::string_view &_line) override;
+	int  Stream() const                    { return stream; }
+
+	std::streamoff Tell() const override   { return out.Tell() + err.Tell(); }
+	int            Seek(std::streamoff _pos) override { return _pos == Tell() ? 0 : err_seekFailed; }
+	std::streamoff Size() override         { return out.Size() + err.Size(); }	// received so far
+
+	void Clear() override                  {}
+
+	void SetMaxLineSize(size_t _size, CutScan _scan = nullptr) override;		// of both streams
+
+	size_t ReadBlock(std::streamoff, size_t, const char*&) override { return 0; }
+	bool   Seekable() const override       { return false; }
+	bool   Ended() const override          { return out.Ended() && err.Ended(); }
+
+	std::vector<int> PollFds() const override;
+
+	int CheckFile(const std::string&) override { return file_unchanged; }
+
+	const char* Type() const override      { return "command"; }
+
+	// Exit status of the command, as a shell reports it (128 + n if killed by signal n);
+	// it waits for the command to end
+	int ExitStatus();
+
+private:
+	std::vector<std::string>  command;
+
+	int  pid = -1;
+	int  status = -1;		// exit status, once the command has been waited for
+
+	PipeLogReader  out, err;
+	int            stream = stream_stdout;
+};
+
+
+} // log_viewer
+
+
+#endif // CHILD_LOG_READER_HPP
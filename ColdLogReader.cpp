@@ -0,0 +1,344 @@
+/******************************************************************************
+ * ColdLogReader.cpp
+ *
+ * Input layer: one pass over large historical log files, at device speed,
+ * without filling the page cache (--reader cold, --reader direct).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "ColdLogReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace log_viewer {
+
+
+#ifdef POSIX
+
+ColdLogReader::~ColdLogReader()
+{
+	Close();
+	std::free(ahead);
+}
+
+
+int ColdLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	if(ahead == nullptr && posix_memalign(reinterpret_cast<void**>(&ahead), alignment, blockSize) != 0) {
+		ahead = nullptr;
+		return err_openFailed;
+	}
+
+	int flags = O_RDONLY | O_CLOEXEC;
+
+#ifdef O_DIRECT
+	if(direct)
+		flags |= O_DIRECT;
+#endif
+
+	fd = open(_fileName.c_str(), flags);
+
+	// O_DIRECT not supported by the file system: the hints below still spare the page cache
+	if(fd < 0 && errno == EINVAL && flags != (O_RDONLY | O_CLOEXEC))
+		fd = open(_fileName.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0)
+		return err_openFailed;
+
+#if defined(F_NOCACHE) && !defined(O_DIRECT)
+	if(direct)
+		fcntl(fd, F_NOCACHE, 1);
+#endif
+
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);		// larger read ahead by the kernel
+#endif
+
+	struct stat st;
+	inode = (fstat(fd, &st) == 0) ? uint64_t(st.st_ino) : 0;
+
+	return 0;
+}
+
+
+void ColdLogReader::Close()
+{
+	Settle();
+
+#ifdef POSIX_FADV_DONTNEED
+	// The rest of the pages read
+	if(fd >= 0)
+		posix_fadvise(fd, off_t(forgotten), 0, POSIX_FADV_DONTNEED);
+#endif
+
+	if(fd >= 0)
+		close(fd);
+
+	fd = -1;
+	winLen = 0;
+	winPos = 0;
+	forgotten = 0;
+	cursor = 0;
+	scanned = 0;
+	ResetCut();
+}
+
+
+bool ColdLogReader::GetLine(std::string_view &_line)
+{
+	if(fd < 0)
+		return false;
+
+	while(true)
+	{
+		// At least one byte more than those already searched, if the file has it
+		const char *data = nullptr;
+		const size_t n = Fill(cursor, scanned + 1, data);
+
+		const char *nl = static_cast<const char*>(std::memchr(data + scanned, '\n', n - scanned));
+
+		if(nl != nullptr)
+		{
+			const size_t len = size_t(nl - data);
+			_line = Cut(std::string_view(data, len));
+			cursor += std::streamoff(len + 1);
+			scanned = 0;
+			return true;
+		}
+
+		if(n == scanned)
+		{
+			// End of the file; a partial line is searched no more, when the file grows
+			if(n == 0 || holdPartial)
+				return false;
+
+			// Without a new line at the end of the file, return the rest, as getline() would do
+			_line = Cut(std::string_view(data, n));
+			cursor += std::streamoff(n);
+			scanned = 0;
+			return true;
+		}
+
+		scanned = n;
+
+		if(maxLineSize > 0 && scanned > maxLineSize)
+			return SkipLine(_line);
+	}
+}
+
+
+bool ColdLogReader::SkipLine(std::string_view &_line)
+{
+	// Its beginning is set apart, so that the window does not have to hold the line
+	const char *data = nullptr;
+	Fill(cursor, scanned, data);
+
+	line.assign(data, maxLineSize);
+	StartCut(line);
+	Skip(data + maxLineSize, scanned - maxLineSize);
+
+	// The rest goes through the window a block at a time
+	std::streamoff from = cursor + std::streamoff(scanned);
+	bool newLine = false;
+
+	while(newLine == false)
+	{
+		const size_t n = Fill(from, 1, data);
+
+		if(n == 0)
+			break;
+
+		const char *nl = static_cast<const char*>(std::memchr(data, '\n', n));
+		const size_t len = (nl != nullptr) ? size_t(nl - data) : n;
+
+		Skip(data, len);
+		from += std::streamoff(len);
+		newLine = (nl != nullptr);
+	}
+
+	cursor = from + (newLine ? 1 : 0);
+	scanned = 0;
+
+	EndLine();
+	_line = line;
+	return true;
+}
+
+
+int ColdLogReader::Seek(std::streamoff _pos)
+{
+	cursor = std::max(_pos, std::streamoff(0));
+	scanned = 0;
+	ResetCut();
+
+	return 0;
+}
+
+
+std::streamoff ColdLogReader::Size()
+{
+	struct stat st;
+
+	if(fd < 0 || fstat(fd, &st) != 0)
+		return -1;
+
+	return std::streamoff(st.st_size);
+}
+
+
+size_t ColdLogReader::ReadBlock(std::streamoff _pos, size_t _size, const char *&_block)
+{
+	if(fd < 0)
+		return 0;
+
+	return std::min(Fill(_pos, _size, _block), _size);
+}
+
+
+size_t ColdLogReader::Fill(std::streamoff _pos, size_t _size, const char *&_data)
+{
+	// A jump: start again from there
+	if(_pos < winPos || _pos > winPos + std::streamoff(winLen))
+	{
+		Settle();
+		winPos = _pos;
+		winLen = 0;
+	}
+
+	size_t offset = size_t(_pos - winPos);
+
+	if(winLen - offset < _size)
+	{
+		// Keep the bytes from _pos on; the ones before are done with
+		std::memmove(window.data(), window.data() + offset, winLen - offset);
+		winLen -= offset;
+		winPos = _pos;
+		offset = 0;
+
+		Forget(_pos);
+
+		while(winLen < _size && TakeBlock() > 0)
+			;
+	}
+
+	_data = window.data() + offset;
+	return winLen - offset;
+}
+
+
+size_t ColdLogReader::TakeBlock()
+{
+	const std::streamoff pos = winPos + std::streamoff(winLen);
+	std::streamoff n;
+
+	if(aheadRead.valid() && aheadPos == pos) {
+		n = aheadRead.get();
+	}
+	else {
+		Settle();
+		n = ReadAt(pos);
+	}
+
+	aheadPos = -1;
+
+	// The block starts at the aligned offset before pos
+	const size_t skip = size_t(pos % std::streamoff(alignment));
+
+	if(n <= std::streamoff(skip))
+		return 0;
+
+	const size_t size = size_t(n) - skip;
+
+	if(window.size() < winLen + size)
+		window.resize(std::max(winLen + size, 2 * window.size()));
+
+	std::memcpy(window.data() + winLen, ahead + skip, size);
+	winLen += size;
+
+	// A full block: read the next one while this one is scanned
+	if(n == std::streamoff(blockSize))
+	{
+		aheadPos = winPos + std::streamoff(winLen);
+		aheadRead = std::async(std::launch::async, [this](std::streamoff _p) { return ReadAt(_p); }, aheadPos);
+	}
+
+	return size;
+}
+
+
+std::streamoff ColdLogReader::ReadAt(std::streamoff _pos)
+{
+	const std::streamoff start = _pos - _pos % std::streamoff(alignment);
+	ssize_t n;
+
+	do {
+		n = pread(fd, ahead, blockSize, off_t(start));
+	} while(n < 0 && errno == EINTR);
+
+#ifdef O_DIRECT
+	// O_DIRECT accepted by open() but not by read()
+	if(n < 0 && errno == EINVAL && (fcntl(fd, F_GETFL) & O_DIRECT))
+	{
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+		n = pread(fd, ahead, blockSize, off_t(start));
+	}
+#endif
+
+	return std::streamoff(n);
+}
+
+
+void ColdLogReader::Settle()
+{
+	if(aheadRead.valid())
+		aheadRead.get();
+
+	aheadPos = -1;
+}
+
+
+void ColdLogReader::Forget(std::streamoff _pos)
+{
+#ifdef POSIX_FADV_DONTNEED
+	// Whole blocks, one behind: the kernel keeps the large pages (folios) partly outside the range,
+	// and the pages read last may still be on its per-CPU lists
+	std::streamoff upTo = std::max(_pos - std::streamoff(blockSize), std::streamoff(0));
+	upTo -= upTo % std::streamoff(blockSize);
+
+	if(upTo < forgotten)
+		forgotten = upTo;
+
+	// A block at a time, not at every line
+	if(upTo - forgotten >= std::streamoff(blockSize)) {
+		posix_fadvise(fd, off_t(forgotten), off_t(upTo - forgotten), POSIX_FADV_DONTNEED);
+		forgotten = upTo;
+	}
+#else
+	(void)_pos;
+#endif
+}
+
+#endif // POSIX
+
+
+} // log_viewer
@@ -0,0 +1,97 @@
+/******************************************************************************
+ * ColdLogReader.hpp
+ *
+ * Input layer: one pass over large historical log files, at device speed,
+ * without filling the page cache (--reader cold, --reader direct).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef COLD_LOG_READER_HPP
+#define COLD_LOG_READER_HPP
+
+#include "LogReader.hpp"
+
+#include <future>
+#include <string>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class ColdLogReader : public LogReader
+{
+	/** The file is read in large aligned blocks, the next one on another thread
+	 *  while the current one is being scanned (double buffering). The blocks
+	 *  are copied into a window, where the lines and the blocks asked by
+	 *  ReadBlock() are contiguous.
+	 *  cold:   the kernel is told the reading is sequential, and the pages
+	 *          already read are dropped from the page cache;
+	 *  direct: O_DIRECT, the page cache is not used at all (where the file
+	 *          system does not support it, the reader works as cold).
+	 *  Reading backwards (e.g. --nLatest) works, but each jump costs a block.
+	 */
+
+public:
+	static const size_t blockSize = 4 << 20;
+	static const size_t alignment = 4096;		// of the reads, for O_DIRECT
+
+	explicit ColdLogReader(bool _direct = false) : direct(_direct) {}
+	~ColdLogReader() override;
+
+	int  Open(const std::string &_fileName) override;
+	void Close() override;
+	bool IsOpen() const override           { return fd >= 0; }
+
+	bool GetLine(std::string_view &_line) override;
+
+	std::streamoff Tell() const override   { return cursor; }
+	int            Seek(std::streamoff _pos) override;
+	std::streamoff Size() override;
+
+	void Clear() override                  {}
+
+	size_t ReadBlock(std::streamoff _pos, size_t _size, const char *&_block) override;
+
+	const char* Type() const override      { return direct ? "direct" : "cold"; }
+
+private:
+	// Make the bytes from _pos contiguous in the window, at least _size of them if the file has them;
+	// return the number available from _pos
+	size_t Fill(std::streamoff _pos, size_t _size, const char *&_data);
+
+	size_t          TakeBlock();					// append the next block of the file to the window
+	std::streamoff  ReadAt(std::streamoff _pos);	// read the aligned block containing _pos into ahead
+	void            Settle();						// wait for the read in flight, if any
+	void            Reserve(size_t _size);			// window capacity
+	void            Forget(std::streamoff _pos);	// drop the pages before _pos from the page cache
+
+	bool  SkipLine(std::string_view &_line);		// a line longer than maxLineSize, from cursor
+
+	bool  direct;
+	int   fd = -1;
+
+	std::vector<char>  window;			// file bytes from winPos
+	size_t             winLen = 0;
+	std::streamoff     winPos = 0;
+
+	char                        *ahead = nullptr;	// block read ahead, at aheadPos
+	std::streamoff               aheadPos = -1;
+	std::future<std::streamoff>  aheadRead;
+
+	std::streamoff  forgotten = 0;		// pages dropped up to here
+	std::streamoff  cursor = 0;			// offset of the next line
+	size_t          scanned = 0;		// bytes after cursor already searched for a new line
+	std::string     line;				// beginning of a line longer than maxLineSize
+};
+
+
+} // log_viewer
+
+
+#endif // COLD_LOG_READER_HPP
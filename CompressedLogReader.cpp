@@ -0,0 +1,440 @@
+/******************************************************************************
+ * CompressedLogReader.cpp
+ *
+ * Input layer: read a gzip or zstd compressed log file line by line,
+ * decompressing it on a separate thread, without temporary files.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "CompressedLogReader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+
+namespace log_viewer {
+
+
+/// Streaming decompression of one format
+
+class CompressedLogReader::Decoder
+{
+public:
+	virtual ~Decoder() {}
+
+	// Decompress as much as possible from _in to _out, advancing both; false if the data is corrupt
+	virtual bool Decode(const char *&_in, const char *_inEnd, char *&_out, char *_outEnd) = 0;
+
+	// The data decoded so far ends with a complete gzip member or zstd frame
+	bool EndOfStream() const { return ended; }
+
+protected:
+	bool ended = false;
+};
+
+
+#ifdef HAVE_ZLIB
+
+class GzipDecoder : public CompressedLogReader::Decoder
+{
+public:
+	GzipDecoder()  { inflateInit2(&zs, 16 + MAX_WBITS); }		// gzip header only
+	~GzipDecoder() { inflateEnd(&zs); }
+
+	bool Decode(const char *&_in, const char *_inEnd, char *&_out, char *_outEnd) override
+	{
+		if(ended)
+		{
+			if(_in == _inEnd)
+				return true;
+
+			inflateReset(&zs);		// concatenated members, as written by gzip >>
+			ended = false;
+		}
+
+		zs.next_in   = reinterpret_cast<Bytef*>(const_cast<char*>(_in));
+		zs.avail_in  = uInt(_inEnd - _in);
+		zs.next_out  = reinterpret_cast<Bytef*>(_out);
+		zs.avail_out = uInt(_outEnd - _out);
+
+		const int r = inflate(&zs, Z_NO_FLUSH);
+
+		_in  = reinterpret_cast<const char*>(zs.next_in);
+		_out = reinterpret_cast<char*>(zs.next_out);
+
+		if(r == Z_STREAM_END)
+			ended = true;
+
+		return r == Z_OK || r == Z_STREAM_END || r == Z_BUF_ERROR;
+	}
+
+private:
+	z_stream zs = z_stream();
+};
+
+#endif // HAVE_ZLIB
+
+
+#ifdef HAVE_ZSTD
+
+class ZstdDecoder : public CompressedLogReader::Decoder
+{
+public:
+	ZstdDecoder()  { ds = ZSTD_createDStream(); ZSTD_initDStream(ds); }
+	~ZstdDecoder() { ZSTD_freeDStream(ds); }
+
+	bool Decode(const char *&_in, const char *_inEnd, char *&_out, char *_outEnd) override
+	{
+		ZSTD_inBuffer  in  = { _in, size_t(_inEnd - _in), 0 };
+		ZSTD_outBuffer out = { _out, size_t(_outEnd - _out), 0 };
+
+		const size_t r = ZSTD_decompressStream(ds, &out, &in);
+
+		_in  += in.pos;
+		_out += out.pos;
+
+		if(ZSTD_isError(r))
+			return false;
+
+		// 0: a frame is complete and flushed; the next one, if any, starts by itself
+		if(in.pos > 0 || out.pos > 0)
+			ended = (r == 0);
+
+		return true;
+	}
+
+private:
+	ZSTD_DStream *ds;
+};
+
+#endif // HAVE_ZSTD
+
+
+int CompressedLogReader::Detect(const std::string &_fileName)
+{
+	unsigned char magic[4] = { 0, 0, 0, 0 };
+
+	std::ifstream ifs(_fileName, std::ios::binary);
+	ifs.read(reinterpret_cast<char*>(magic), sizeof(magic));
+
+	if(ifs.gcount() < 2)
+		return codec_none;
+
+	if(magic[0] == 0x1f && magic[1] == 0x8b)
+		return codec_gzip;
+
+	if(magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd)
+		return codec_zstd;
+
+	return codec_none;
+}
+
+
+bool CompressedLogReader::Available(int _codec)
+{
+#ifdef HAVE_ZLIB
+	if(_codec == codec_gzip)
+		return true;
+#endif
+#ifdef HAVE_ZSTD
+	if(_codec == codec_zstd)
+		return true;
+#endif
+
+	return false;
+}
+
+
+const char* CompressedLogReader::CodecName(int _codec)
+{
+	switch(_codec) {
+		case codec_gzip: return "gzip";
+		case codec_zstd: return "zstd";
+		default:         return "none";
+	}
+}
+
+
+int CompressedLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	codec = Detect(_fileName);
+
+	Decoder *dec = nullptr;
+
+#ifdef HAVE_ZLIB
+	if(codec == codec_gzip)
+		dec = new GzipDecoder;
+#endif
+#ifdef HAVE_ZSTD
+	if(codec == codec_zstd)
+		dec = new ZstdDecoder;
+#endif
+
+	if(dec == nullptr)
+		return err_openFailed;
+
+	file = fopen(_fileName.c_str(), "rb");
+
+	if(file == nullptr) {
+		delete dec;
+		return err_openFailed;
+	}
+
+	struct stat st;
+	inode = (stat(_fileName.c_str(), &st) == 0) ? uint64_t(st.st_ino) : 0;
+
+	fileName = _fileName;
+
+	ring.reset(new SpscRing<std::string>(ringSize));
+	stop = false;
+	idle = false;
+	finished = false;
+	decoded = 0;
+
+	decoder = std::thread(&CompressedLogReader::DecoderLoop, this, dec);
+
+	return 0;
+}
+
+
+void CompressedLogReader::Close()
+{
+	if(decoder.joinable()) {
+		stop = true;
+		ring->Wake();
+		decoder.join();
+	}
+
+	if(file != nullptr)
+		fclose(file);
+
+	file = nullptr;
+	ring.reset();
+
+	block.clear();
+	blockPos = 0;
+	partial.clear();
+	consumed = 0;
+	ResetCut();
+}
+
+
+bool CompressedLogReader::GetLine(std::string_view &_line)
+{
+	while(true)
+	{
+		if(blockPos < block.size())
+		{
+			const char  *begin = block.data() + blockPos;
+			const size_t avail = block.size() - blockPos;
+			const char  *nl = static_cast<const char*>(std::memchr(begin, '\n', avail));
+
+			if(nl == nullptr) {
+				// The line continues in the next block (only its first maxLineSize bytes, if limited)
+				Collect(partial, begin, avail);
+				blockPos = block.size();
+				consumed += std::streamoff(avail);
+				continue;
+			}
+
+			const size_t len = size_t(nl - begin);
+			blockPos += len + 1;
+			consumed += std::streamoff(len + 1);
+
+			if(partial.empty()) {
+				_line = Cut(std::string_view(begin, len));
+			}
+			else {
+				line.swap(partial);
+				line.append(begin, len);
+				partial.clear();
+				_line = Cut(line);
+			}
+
+			return true;
+		}
+
+		if(NextBlock())
+			continue;
+
+		// Without a new line at the end of the file, return the rest, as getline() would do
+		if(finished.load() && partial.empty() == false) {
+			line.swap(partial);
+			partial.clear();
+			_line = Cut(line);
+			return true;
+		}
+
+		return false;
+	}
+}
+
+
+int CompressedLogReader::Seek(std::streamoff _pos)
+{
+	if(_pos < 0)
+		_pos = 0;
+
+	if(_pos < Tell() || (cutting && _pos < consumed))
+	{
+		// The decompressed data is not kept (nor the part skipped of a long line): decode the file again
+		const std::string name = fileName;
+
+		if(Open(name) != 0)
+			return err_seekFailed;
+	}
+
+	// Skip forward, up to the data available
+
+	if(_pos <= consumed) {
+		partial.erase(0, size_t(_pos - Tell()));
+		return 0;
+	}
+
+	partial.clear();
+	ResetCut();
+
+	while(consumed < _pos && (blockPos < block.size() || NextBlock()))
+	{
+		const size_t n = std::min(block.size() - blockPos, size_t(_pos - consumed));
+		blockPos += n;
+		consumed += std::streamoff(n);
+	}
+
+	return 0;
+}
+
+
+int CompressedLogReader::CheckFile(const std::string &_fileName)
+{
+	struct stat st;
+
+	if(stat(_fileName.c_str(), &st) != 0)
+		return file_missing;
+
+	// Compressed files are replaced, not truncated
+	if(!IsOpen() || uint64_t(st.st_ino) != inode)
+		return file_rotated;
+
+	return file_unchanged;
+}
+
+
+/// Wait for the next decompressed block, while the decoder has data; false if there is none for now
+
+bool CompressedLogReader::NextBlock()
+{
+	if(!ring)
+		return false;
+
+	block.clear();
+	blockPos = 0;
+
+	if(ring->Pop(block, idle))
+		return true;
+
+	// The decoder may have pushed its last block just before finishing
+	return finished.load() && ring->TryPop(block);
+}
+
+
+void CompressedLogReader::DecoderLoop(Decoder *_decoder)
+{
+	const std::unique_ptr<Decoder> dec(_decoder);
+	const std::chrono::milliseconds poll(100);		// while waiting for a file being written
+
+	std::vector<char> input(256 << 10);
+	const char *in = input.data(), *inEnd = in;
+	bool atEof = false;
+	bool corrupt = false;
+
+	std::string out(blockSize, '\0');
+	char *o = &out[0];
+
+	while(stop.load() == false)
+	{
+		if(in == inEnd && atEof == false)
+		{
+			const size_t n = fread(input.data(), 1, input.size(), file);
+
+			if(n > 0) {
+				in = input.data();
+				inEnd = in + n;
+				idle = false;
+			}
+			else {
+				atEof = true;
+			}
+		}
+
+		char *const o0 = o;
+
+		if(corrupt == false && dec->Decode(in, inEnd, o, &out[0] + out.size()) == false) {
+			std::cerr << "logviewer: warning: corrupt " << CodecName(codec) << " data in " << fileName
+			          << "; it is read up to this point." << std::endl;
+			corrupt = true;
+		}
+
+		if(corrupt) {
+			in = inEnd;
+			atEof = true;
+		}
+
+		const bool drained = (in == inEnd && o == o0);		// nothing more to decode from the input read so far
+
+		// Pass on full blocks, and whatever is available when the file ends
+		if(o == &out[0] + out.size() || (drained && atEof && o != &out[0]))
+		{
+			out.resize(size_t(o - &out[0]));
+			decoded += std::streamoff(out.size());
+
+			if(ring->Push(std::move(out), stop) == false)
+				return;
+
+			out.assign(blockSize, '\0');
+			o = &out[0];
+		}
+
+		if(drained && atEof)
+		{
+			if(dec->EndOfStream() || corrupt)
+				break;
+
+			// The file is still being written
+			idle = true;
+			ring->Wake();
+
+			std::this_thread::sleep_for(poll);
+			clearerr(file);
+			atEof = false;
+		}
+	}
+
+	finished = true;
+	idle = true;
+	ring->Wake();
+}
+
+
+} // log_viewer
@@ -0,0 +1,103 @@
+/******************************************************************************
+ * CompressedLogReader.hpp
+ *
+ * Input layer: read a gzip or zstd compressed log file line by line,
+ * decompressing it on a separate thread, without temporary files.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef COMPRESSED_LOG_READER_HPP
+#define COMPRESSED_LOG_READER_HPP
+
+#include "LogReader.hpp"
+#include "RingBuffer.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+
+
+namespace log_viewer {
+
+
+class CompressedLogReader : public LogReader
+{
+	/** The decoder thread reads the file and pushes blocks of decompressed
+	 *  data on a ring; GetLine() splits them into lines. Offsets refer to the
+	 *  decompressed data, which is not kept: seeking backwards decodes the
+	 *  file again from its beginning.
+	 *  At the end of a complete file the decoder stops; at the end of a file
+	 *  still being written it waits for more data, as for a plain log file.
+	 */
+
+public:
+	// Compression formats, found by their magic bytes
+	static const int codec_none = 0,
+	                 codec_gzip = 1,
+	                 codec_zstd = 2;
+
+	static int         Detect(const std::string &_fileName);
+	static bool        Available(int _codec);
+	static const char* CodecName(int _codec);
+
+	class Decoder;						// streaming decompression of one format
+
+	~CompressedLogReader() override        { Close(); }
+
+	int  Open(const std::string &_fileName) override;
+	void Close() override;
+	bool IsOpen() const override           { return file != nullptr; }
+
+	bool GetLine(std::string_view &_line) override;
+
+	std::streamoff Tell() const override   { return consumed - std::streamoff(partial.size() + skipped); }
+	int            Seek(std::streamoff _pos) override;
+	std::streamoff Size() override         { return decoded.load(); }	// decompressed so far
+
+	void Clear() override                  {}
+
+	size_t ReadBlock(std::streamoff, size_t, const char*&) override { return 0; }
+	bool   Seekable() const override       { return false; }
+
+	int CheckFile(const std::string &_fileName) override;
+
+	const char* Type() const override      { return CodecName(codec); }
+
+private:
+	static const size_t blockSize = 1 << 20;	// decompressed data per ring slot
+	static const size_t ringSize = 8;
+
+	void DecoderLoop(Decoder *_decoder);
+	bool NextBlock();
+
+	std::string  fileName;
+	FILE        *file = nullptr;
+	int          codec = codec_none;
+
+	std::unique_ptr<SpscRing<std::string>>  ring;
+	std::thread  decoder;
+
+	std::atomic<bool>            stop{false};
+	std::atomic<bool>            idle{false};		// no more data for now
+	std::atomic<bool>            finished{false};	// end of the compressed data
+	std::atomic<std::streamoff>  decoded{0};
+
+	std::string     block;				// decompressed data being split into lines
+	size_t          blockPos = 0;
+	std::string     partial;			// beginning of a line, from the previous blocks
+	std::string     line;
+	std::streamoff  consumed = 0;		// decompressed bytes taken from the blocks
+};
+
+
+} // log_viewer
+
+
+#endif // COMPRESSED_LOG_READER_HPP
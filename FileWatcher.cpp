@@ -0,0 +1,300 @@
+/******************************************************************************
+ * FileWatcher.cpp
+ *
+ * Wait for changes of the log file, instead of polling it at fixed intervals.
+ * On Linux it uses inotify; elsewhere it falls back to a plain pause.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "FileWatcher.hpp"
+
+#include <algorithm>
+#include <thread>
+
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+namespace log_viewer {
+
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher()
+{
+	notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+}
+
+
+FileWatcher::~FileWatcher()
+{
+	Disable();
+}
+
+
+int FileWatcher::Watch(const std::string &_fileName)
+{
+	Unwatch();
+
+	return Add(_fileName);
+}
+
+
+int FileWatcher::Add(const std::string &_fileName)
+{
+	if(notifyFd < 0)
+		return -1;
+
+	Target t;
+	t.watchId = inotify_add_watch(notifyFd, _fileName.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF);
+
+	// Watch the directory too, to know when a rotated file is recreated
+	// (files in the same directory share its watch)
+	const size_t slash = _fileName.find_last_of('/');
+	const std::string dir = (slash == std::string::npos) ? "." : _fileName.substr(0, slash + 1);
+	t.fileName = _fileName;
+	t.baseName = (slash == std::string::npos) ? _fileName : _fileName.substr(slash + 1);
+
+	t.dirWatchId = inotify_add_watch(notifyFd, dir.c_str(), IN_CREATE | IN_MOVED_TO | IN_ONLYDIR | IN_MASK_ADD);
+
+	targets.push_back(t);
+
+	return t.watchId;
+}
+
+
+int FileWatcher::AddDir(const std::string &_prefix)
+{
+	if(notifyFd < 0)
+		return -1;
+
+	Target t;
+	t.fileName = _prefix;
+
+	// The events of all the files in the directory, with their names
+	t.dirWatchId = inotify_add_watch(notifyFd, _prefix.empty() ? "." : _prefix.c_str(),
+	                                 IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM |
+	                                 IN_ONLYDIR | IN_MASK_ADD);
+
+	targets.push_back(t);
+
+	return t.dirWatchId;
+}
+
+
+void FileWatcher::Unwatch()
+{
+	for(const Target &t : targets)
+	{
+		if(notifyFd >= 0 && t.watchId >= 0)
+			inotify_rm_watch(notifyFd, t.watchId);
+
+		if(notifyFd >= 0 && t.dirWatchId >= 0)
+			inotify_rm_watch(notifyFd, t.dirWatchId);
+	}
+
+	targets.clear();
+}
+
+
+bool FileWatcher::Watching() const
+{
+	for(const Target &t : targets)
+		if(t.watchId >= 0 || (t.baseName.empty() && t.dirWatchId >= 0))
+			return true;
+
+	return false;
+}
+
+
+int FileWatcher::Wait(std::chrono::milliseconds _timeout, bool _checkInput)
+{
+	const bool files = notifyFd >= 0 && targets.empty() == false;
+
+	changed.clear();
+
+	if(files == false && streamFds.empty()) {
+		std::this_thread::sleep_for(_timeout);
+		return evt_timeout;
+	}
+
+	// Keyboard input is only checked on a terminal: a closed or redirected stdin is always readable
+	_checkInput = _checkInput && isatty(STDIN_FILENO) &&
+	              std::find(streamFds.begin(), streamFds.end(), STDIN_FILENO) == streamFds.end();
+
+	std::vector<struct pollfd> fds(streamFds.size() + 2);
+	int nFds = 0, iNotify = -1, iStream = -1, iInput = -1;
+
+	if(files) {
+		fds[nFds].fd = notifyFd;
+		fds[nFds].events = POLLIN;
+		iNotify = nFds++;
+	}
+
+	iStream = nFds;
+
+	for(int fd : streamFds) {
+		fds[nFds].fd = fd;
+		fds[nFds].events = POLLIN;
+		++nFds;
+	}
+
+	if(_checkInput) {
+		fds[nFds].fd = STDIN_FILENO;
+		fds[nFds].events = POLLIN;
+		iInput = nFds++;
+	}
+
+	const int r = poll(fds.data(), nfds_t(nFds), int(_timeout.count()));
+
+	if(r <= 0)
+		return evt_timeout;
+
+	int events = evt_timeout;
+
+	if(iInput >= 0 && (fds[iInput].revents & POLLIN))
+		events |= evt_input;
+
+	// New data, or the writer has closed the pipe
+	for(size_t s = 0; s < streamFds.size(); ++s)
+		if(fds[size_t(iStream) + s].revents & (POLLIN | POLLHUP))
+			events |= evt_modified;
+
+	if(iNotify >= 0 && (fds[iNotify].revents & POLLIN))
+	{
+		// Drain all the pending events
+		alignas(struct inotify_event) char buf[4096];
+		ssize_t len;
+
+		while((len = read(notifyFd, buf, sizeof(buf))) > 0)
+		{
+			for(char *p = buf; p < buf + len; )
+			{
+				const struct inotify_event *evt = reinterpret_cast<const struct inotify_event*>(p);
+
+				for(Target &t : targets)
+				{
+					if(evt->wd == t.dirWatchId && t.baseName.empty())
+					{
+						// Any file of a whole directory
+						if(evt->len == 0)
+							continue;
+
+						if(evt->mask & (IN_CREATE | IN_MOVED_TO))    events |= evt_created;
+						if(evt->mask & (IN_MODIFY | IN_CLOSE_WRITE))  events |= evt_modified;
+						if(evt->mask & (IN_DELETE | IN_MOVED_FROM))   events |= evt_deleted;
+
+						changed.push_back(t.fileName + evt->name);
+					}
+					else if(evt->wd == t.dirWatchId)
+					{
+						if((evt->mask & (IN_CREATE | IN_MOVED_TO)) && evt->len > 0 && t.baseName == evt->name) {
+							events |= evt_created;
+							changed.push_back(t.fileName);
+						}
+					}
+					else if(evt->wd == t.watchId)
+					{
+						changed.push_back(t.fileName);
+
+						if(evt->mask & (IN_MODIFY | IN_CLOSE_WRITE))  events |= evt_modified;	// also after a truncation
+						if(evt->mask & IN_MOVE_SELF)                  events |= evt_moved;
+						if(evt->mask & IN_DELETE_SELF)                events |= evt_deleted;
+						if(evt->mask & IN_IGNORED)                    t.watchId = -1;	// the watch has been removed by the kernel
+					}
+				}
+
+				p += sizeof(struct inotify_event) + evt->len;
+			}
+		}
+	}
+
+	return events;
+}
+
+
+void FileWatcher::Disable()
+{
+	Unwatch();
+
+	if(notifyFd >= 0)
+		close(notifyFd);
+
+	notifyFd = -1;
+}
+
+#else // no file events available
+
+FileWatcher::FileWatcher()  {}
+FileWatcher::~FileWatcher() {}
+
+int  FileWatcher::Watch(const std::string &_fileName) { return -1; }
+int  FileWatcher::Add(const std::string &_fileName)   { return -1; }
+int  FileWatcher::AddDir(const std::string &_prefix)  { return -1; }
+void FileWatcher::Unwatch() {}
+bool FileWatcher::Watching() const { return false; }
+void FileWatcher::Disable() {}
+
+int FileWatcher::Wait(std::chrono::milliseconds _timeout, bool _checkInput)
+{
+	std::this_thread::sleep_for(_timeout);
+	return evt_timeout;
+}
+
+#endif // __linux__
+
+
+/// FileActivity
+
+bool FileActivity::Changed(const std::string &_fileName)
+{
+	if(skip > 0) {
+		--skip;
+		return false;
+	}
+
+	struct stat st;
+	int64_t  newSize = -1, newTime = 0;
+	uint64_t newInode = 0;
+
+	if(stat(_fileName.c_str(), &st) == 0)
+	{
+		newSize = int64_t(st.st_size);
+		newInode = uint64_t(st.st_ino);
+#ifdef __linux__
+		newTime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+		newTime = int64_t(st.st_mtime) * 1000000000;
+#endif
+	}
+
+	if(valid && newSize == size && newTime == mtime && newInode == inode)
+	{
+		// Quiet: back off
+		backoff = (backoff == 0) ? 1 : std::min(2 * backoff, maxBackoff);
+		skip = backoff - 1;
+		return false;
+	}
+
+	valid = true;
+	size = newSize;
+	mtime = newTime;
+	inode = newInode;
+
+	Wake();
+	return true;
+}
+
+
+} // log_viewer
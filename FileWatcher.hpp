@@ -0,0 +1,118 @@
+/******************************************************************************
+ * FileWatcher.hpp
+ *
+ * Wait for changes of the log file, instead of polling it at fixed intervals.
+ * On Linux it uses inotify; elsewhere it falls back to a plain pause.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class FileWatcher
+{
+public:
+	// Events returned by Wait(), as a bit mask
+	static const int evt_timeout  = 0,
+	                 evt_modified = 1,		// data appended to the file
+	                 evt_moved    = 2,		// file renamed (e.g. rotated)
+	                 evt_deleted  = 4,
+	                 evt_input    = 8,		// keyboard input available
+	                 evt_created  = 16;		// a file with the watched name appeared (e.g. after a rotation)
+
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Start watching a file, and its name in its directory; a previous watch is removed
+	int  Watch(const std::string &_fileName);
+	// Watch one more file
+	int  Add(const std::string &_fileName);
+	// Watch all the files in a directory, with one watch; _prefix is the directory with its final slash, or empty
+	int  AddDir(const std::string &_prefix);
+
+	// Wake up when data can be read from _fd (e.g. the standard input, as a pipe), or from any of _fds
+	void WatchStream(int _fd) { streamFds.assign(1, _fd); }
+	void WatchStreams(const std::vector<int> &_fds) { streamFds = _fds; }
+	void Unwatch();
+
+	// True if file events are available; otherwise Wait() is a plain pause
+	bool Available() const { return notifyFd >= 0; }
+	bool Watching()  const;
+
+	// Block until the watched file changes, the keyboard is hit, or the timeout expires
+	int  Wait(std::chrono::milliseconds _timeout, bool _checkInput = true);
+
+	// Files with events at the last Wait(): as given to Add(), or prefix + name for AddDir()
+	const std::vector<std::string>& Changed() const { return changed; }
+
+	void Disable();		// fall back to a plain pause
+
+private:
+	struct Target
+	{
+		int  watchId = -1;
+		int  dirWatchId = -1;
+		std::string  fileName;		// as given to Add(), or the prefix of the files of a directory
+		std::string  baseName;		// name of the watched file in its directory; empty for a whole directory
+	};
+
+	int  notifyFd = -1;
+	std::vector<int>  streamFds;
+	std::vector<Target>  targets;
+	std::vector<std::string>  changed;
+};
+
+
+class FileActivity
+{
+	/** Cheap change detection, where file events are late or missing (e.g. NFS,
+	 *  FUSE) or too many files are followed: the size, modification time and
+	 *  inode of the file are compared with the ones of the previous check, and
+	 *  the file is read only if they differ.
+	 *  A file found unchanged is checked after 1, 2, 4... rounds, up to
+	 *  maxBackoff; a change, or Wake(), makes it hot again.
+	 */
+
+public:
+	static constexpr unsigned maxBackoff = 16;		// rounds between two checks of a quiet file
+
+	// Check the file, if due in this round; true if it may have changed since the previous check
+	bool Changed(const std::string &_fileName);
+
+	void Wake()        { backoff = 0; skip = 0; }				// e.g. after a file event
+	void Invalidate()  { valid = false; Wake(); }				// the next check reports a change
+
+	bool Hot() const   { return backoff <= 1; }
+
+private:
+	bool      valid = false;
+	int64_t   size = -1;			// -1: missing
+	int64_t   mtime = 0;			// ns
+	uint64_t  inode = 0;
+
+	unsigned  backoff = 0;		// rounds between checks
+	unsigned  skip = 0;			// rounds left before the next check
+};
+
+
+} // log_viewer
+
+
+#endif // FILE_WATCHER_HPP
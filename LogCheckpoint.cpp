@@ -0,0 +1,176 @@
+/******************************************************************************
+ * LogCheckpoint.cpp
+ *
+ * Reading state of a log file, saved to continue where logviewer stopped
+ * at its next start (--resume).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "LogCheckpoint.hpp"
+#include "LogIndex.hpp"
+#include "LogReader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <unistd.h>
+#endif
+
+#include <sys/stat.h>
+
+
+namespace log_viewer {
+
+
+static const char  stateMagic[8] = { 'L', 'V', 'R', 'E', 'S', '0', '1', '\0' };
+
+
+int LogCheckpoint::Load(State &_state) const
+{
+	std::ifstream ifs(stateFile, std::ios::binary);
+	Header header;
+
+	if(!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+	   std::memcmp(header.magic, stateMagic, sizeof(stateMagic)) != 0)
+		return err_noState;
+
+	State s;
+	s.inode = header.inode;
+	s.offset = std::streamoff(header.offset);
+	s.prefixHash = header.prefixHash;
+	s.logNumber = header.logNumber;
+	s.prevLevel = header.prevLevel;
+	s.distPrevLogContext = header.distPrevLogContext;
+
+	for(uint64_t i = 0; i < header.nPastLogs; ++i)
+	{
+		int64_t   number = 0;
+		uint64_t  size = 0;
+
+		if(!ifs.read(reinterpret_cast<char*>(&number), sizeof(number)) ||
+		   !ifs.read(reinterpret_cast<char*>(&size), sizeof(size)) || size > (1u << 30))
+			return err_noState;
+
+		std::string text(size_t(size), '\0');
+
+		if(!ifs.read(&text[0], std::streamsize(size)))
+			return err_noState;
+
+		s.pastLogs.emplace_back(int(number), std::move(text));
+	}
+
+	_state = std::move(s);
+
+	return 0;
+}
+
+
+int LogCheckpoint::Save(const State &_state)
+{
+	if(stateFile.empty())
+		return 0;
+
+	lastSave = Clock::now();
+
+	Header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, stateMagic, sizeof(stateMagic));
+	header.inode = _state.inode;
+	header.offset = uint64_t(_state.offset);
+	header.prefixHash = _state.prefixHash;
+	header.logNumber = _state.logNumber;
+	header.prevLevel = int32_t(_state.prevLevel);
+	header.distPrevLogContext = int32_t(_state.distPrevLogContext);
+	header.nPastLogs = _state.pastLogs.size();
+
+	// Nothing read since the last save
+	if(saved && std::memcmp(&header, &lastHeader, sizeof(header)) == 0)
+		return 0;
+
+	// The new state replaces the old one only when complete
+	const std::string tmpFile = stateFile + ".tmp";
+	FILE *f = std::fopen(tmpFile.c_str(), "wb");
+
+	if(f == nullptr)
+		return err_cannotWrite;
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1;
+
+	for(const std::pair<int, std::string> &p : _state.pastLogs)
+	{
+		const int64_t   number = p.first;
+		const uint64_t  size = p.second.size();
+
+		ok = ok && std::fwrite(&number, sizeof(number), 1, f) == 1 &&
+		           std::fwrite(&size, sizeof(size), 1, f) == 1 &&
+		           std::fwrite(p.second.data(), 1, p.second.size(), f) == p.second.size();
+	}
+
+	ok = ok && std::fflush(f) == 0;
+#ifdef POSIX
+	ok = ok && fsync(fileno(f)) == 0;
+#endif
+	ok = (std::fclose(f) == 0) && ok;
+
+#ifndef POSIX
+	if(ok)
+		std::remove(stateFile.c_str());		// rename() does not replace a file here
+#endif
+
+	if(!ok || std::rename(tmpFile.c_str(), stateFile.c_str()) != 0) {
+		std::remove(tmpFile.c_str());
+		return err_cannotWrite;
+	}
+
+	lastHeader = header;
+	saved = true;
+
+	return 0;
+}
+
+
+bool LogCheckpoint::Matches(const State &_state, const std::string &_logFile)
+{
+	struct stat st;
+
+	if(stat(_logFile.c_str(), &st) != 0)
+		return false;
+
+	return uint64_t(st.st_ino) == _state.inode &&
+	       std::streamoff(st.st_size) >= _state.offset &&
+	       PrefixHash(_logFile, _state.offset) == _state.prefixHash;
+}
+
+
+uint64_t LogCheckpoint::PrefixHash(LogReader &_reader, std::streamoff _offset)
+{
+	const char *block = nullptr;
+	const size_t n = _reader.ReadBlock(0, size_t(std::min(_offset, std::streamoff(prefixSize))), block);
+
+	return LogIndex::Hash(block, n);
+}
+
+
+uint64_t LogCheckpoint::PrefixHash(const std::string &_logFile, std::streamoff _offset)
+{
+	char buf[prefixSize];
+
+	std::ifstream ifs(_logFile, std::ios::binary);
+	ifs.read(buf, std::streamsize(std::min(_offset, std::streamoff(prefixSize))));
+
+	return LogIndex::Hash(buf, size_t(ifs.gcount()));
+}
+
+
+} // log_viewer
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * LogCheckpoint.hpp
+ *
+ * Reading state of a log file, saved to continue where logviewer stopped
+ * at its next start (--resume).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef LOG_CHECKPOINT_HPP
+#define LOG_CHECKPOINT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ios>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class LogReader;
+
+
+class LogCheckpoint
+{
+	/** State file layout (native byte order):
+	 *		Header
+	 *		for each past log of the context: int64 log number, uint64 size, text
+	 *
+	 *	The state belongs to a log file with the same inode, a size not smaller
+	 *	than the saved offset, and the same first bytes (prefixHash): a file
+	 *	replaced by another one, or truncated and written again, does not match.
+	 *	Save() writes a temporary file and renames it over the state file, so a
+	 *	crash leaves either the previous state or the new one.
+	 */
+
+public:
+	struct State
+	{
+		uint64_t        inode = 0;
+		std::streamoff  offset = 0;			// of the next line to read
+		uint64_t        prefixHash = 0;		// of the bytes of the file before min(offset, prefixSize)
+		int64_t         logNumber = 0;
+
+		// Context of the logs
+		int  prevLevel = 0;					// inherited by the continuation of a multi-line log
+		int  distPrevLogContext = 0;		// distance from the last log with a context
+		std::vector<std::pair<int, std::string>>  pastLogs;		// log number, text; oldest first
+	};
+
+	static const size_t prefixSize = 4096;
+
+	static const int err_cannotWrite = -1,
+	                 err_noState     = -2;
+
+	explicit LogCheckpoint(const std::string &_stateFile = "") : stateFile(_stateFile) {}
+
+	void SetFile(const std::string &_stateFile) { stateFile = _stateFile; }
+	bool IsOpen() const { return !stateFile.empty(); }
+
+	int  Load(State &_state) const;			// err_noState if missing or corrupted
+	int  Save(const State &_state);			// nothing to write if unchanged since the last save
+
+	// Time to save again, at most once per interval
+	bool Due() const { return Clock::now() - lastSave >= interval; }
+
+	// _logFile is the file the state was saved from
+	static bool Matches(const State &_state, const std::string &_logFile);
+
+	static uint64_t PrefixHash(LogReader &_reader, std::streamoff _offset);
+	static uint64_t PrefixHash(const std::string &_logFile, std::streamoff _offset);
+
+private:
+	typedef std::chrono::steady_clock  Clock;
+
+	struct Header
+	{
+		char      magic[8];
+		uint64_t  inode;
+		uint64_t  offset;
+		uint64_t  prefixHash;
+		int64_t   logNumber;
+		int32_t   prevLevel;
+		int32_t   distPrevLogContext;
+		uint64_t  nPastLogs;
+	};
+
+	std::string  stateFile;
+	Header       lastHeader;
+	bool         saved = false;
+
+	std::chrono::milliseconds  interval = std::chrono::milliseconds(1000);
+	Clock::time_point          lastSave;
+};
+
+
+} // log_viewer
+
+
+#endif // LOG_CHECKPOINT_HPP
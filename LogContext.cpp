@@ -18,7 +18,7 @@
 namespace log_viewer {
 
 
-int LogContext::StorePastLog(const std::string &_log,
+int LogContext::StorePastLog(std::string_view _log,
 							 int _level,
 							 int _minLevel,
 							 int _logNumberPre)
@@ -52,6 +52,21 @@ void LogContext::Erase()
 }
 
 
+std::vector<std::pair<int, std::string>> LogContext::PastLogs() const
+{
+	std::queue<PastLog>  pastLogsTmp(pastLogs);
+	std::vector<std::pair<int, std::string>>  logs;
+
+	while(pastLogsTmp.empty() == false)
+	{
+		logs.emplace_back(pastLogsTmp.front().logNumber, pastLogsTmp.front().log);
+		pastLogsTmp.pop();
+	}
+
+	return logs;
+}
+
+
 void LogContext::Dump() const
 {
 	std::queue<PastLog>  pastLogsTmp(pastLogs);
@@ -16,6 +16,9 @@
 
 #include <queue>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 
 namespace log_viewer {
@@ -27,7 +30,7 @@ public:
 	LogContext() :
 		width(0), minLevelForContext(5 /*ERROR*/), minContextLevel(10 /*context disabled*/) {}
 
-	int StorePastLog(const std::string &_log, int _level, int _minLevel, int _logNumberPre);
+	int StorePastLog(std::string_view _log, int _level, int _minLevel, int _logNumberPre);
 	int ExtractPastLog(std::string &_log);   // return log id/number
 
 	int Width()              const { return width; }
@@ -41,6 +44,10 @@ public:
 
 	void Erase();
 
+	// Past logs as (log number, log), oldest first: to save the context and restore it
+	std::vector<std::pair<int, std::string>> PastLogs() const;
+	void AddPastLog(const std::string &_log, int _logNumber) { pastLogs.push(PastLog(_log, _logNumber)); }
+
 	void Dump() const;
 
 private:
@@ -53,7 +60,7 @@ private:
 		int          logNumber;
 
 		PastLog() : logNumber(0) {}
-		PastLog(const std::string &_log, int _logNum = 0)
+		PastLog(std::string_view _log, int _logNum = 0)
 			: log(_log), logNumber(_logNum) {}
 	};
 
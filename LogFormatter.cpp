@@ -121,7 +121,7 @@ int LogFormatter::CheckFormats(std::string &_formats) const
 
 // Log message formatters
 
-std::string LogFormatter::Format(const std::string &_log,
+std::string LogFormatter::Format(std::string_view _log,
 								 int _level,
 								 const std::string &_file,
 								 char _tag,
@@ -136,7 +136,7 @@ std::string LogFormatter::Format(const std::string &_log,
 }
 
 
-std::string LogFormatter::FormatPlain(const std::string &_log,
+std::string LogFormatter::FormatPlain(std::string_view _log,
 									  int _level,
 									  const std::string &_file,
 									  char _tag,
@@ -150,13 +150,14 @@ std::string LogFormatter::FormatPlain(const std::string &_log,
 	if(_logNumber > 0)
 		fLog += std::to_string(_logNumber) + ": ";
 
-	fLog += _tag + _log;
+	fLog += _tag;
+	fLog += _log;
 
 	return fLog;
 }
 
 
-std::string LogFormatter::FormatConsole(const std::string &_log,
+std::string LogFormatter::FormatConsole(std::string_view _log,
 										int _level,
 										const std::string &_file,
 										char _tag,
@@ -177,23 +178,23 @@ std::string LogFormatter::FormatConsole(const std::string &_log,
 	fLog += std::string(Format(ny));
 #endif
 
-	fLog +=   _tag
-			+ std::string(Format(_level))
-			+ _log
-			+ std::string(Reset());
+	fLog += _tag;
+	fLog += Format(_level);
+	fLog += _log;
+	fLog += Reset();
 
 	return fLog;
 }
 
 
-std::string LogFormatter::FormatMarkdown(const std::string &_log,
+std::string LogFormatter::FormatMarkdown(std::string_view _log,
 										 int _level,
 										 const std::string &_file,
 										 char _tag,
 										 int _logNumber) const
 {
 	//+TODO
-	return _log;
+	return std::string(_log);
 }
 
 
@@ -14,6 +14,7 @@
 #define LOG_FORMATTER_HPP
 
 #include <string>
+#include <string_view>
 
 namespace log_viewer {
 
@@ -42,11 +43,11 @@ public:
 	int CheckFormats(std::string &_formats) const;
 
 	// Log message formatters
-	std::string Format(const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
-	std::string FormatPlain   (const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
-	std::string FormatConsole (const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
-	std::string FormatHTML    (const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
-	std::string FormatMarkdown(const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
+	std::string Format(std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
+	std::string FormatPlain   (std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
+	std::string FormatConsole (std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
+	std::string FormatHTML    (std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
+	std::string FormatMarkdown(std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1) const;
 
 	// Headers
 	std::string Header()         const;
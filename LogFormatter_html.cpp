@@ -18,7 +18,7 @@
 namespace log_viewer {
 
 
-std::string LogFormatter::FormatHTML(const std::string &_log,
+std::string LogFormatter::FormatHTML(std::string_view _log,
                                      int _level,
                                      const std::string &_file,
                                      char _tag,
@@ -38,12 +38,12 @@ std::string LogFormatter::FormatHTML(const std::string &_log,
 	if(_logNumber > 0)
 		htmlLog += std::to_string(_logNumber) + ": ";
 
-	htmlLog +=   _tag
-	           + std::string("<span style=\"")
-	           + htmlLevel[_level]
-	           + std::string("\">")
-	           + _log
-	           + std::string("</span>");
+	htmlLog += _tag;
+	htmlLog += "<span style=\"";
+	htmlLog += htmlLevel[_level];
+	htmlLog += "\">";
+	htmlLog += _log;
+	htmlLog += "</span>";
 
 	return htmlLog;
 }
@@ -0,0 +1,254 @@
+/******************************************************************************
+ * LogIndex.cpp
+ *
+ * Persistent sidecar index of a log file: offset, level and timestamp of
+ * each log, to reload and filter old logs without parsing them again.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "LogIndex.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+
+namespace log_viewer {
+
+
+static const char     indexMagic[8] = { 'L', 'V', 'I', 'D', 'X', '0', '1', '\0' };
+static const size_t   tailHashSize = 64;
+
+
+struct FileStatus
+{
+	uint64_t        inode = 0;
+	int64_t         mtime = 0;		// nanoseconds, where available
+	std::streamoff  size = -1;
+};
+
+
+static FileStatus GetFileStatus(const std::string &_fileName)
+{
+	FileStatus fs;
+	struct stat st;
+
+	if(stat(_fileName.c_str(), &st) != 0)
+		return fs;
+
+	fs.inode = uint64_t(st.st_ino);
+	fs.size  = std::streamoff(st.st_size);
+#ifdef __linux__
+	fs.mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+	fs.mtime = int64_t(st.st_mtime) * 1000000000;
+#endif
+
+	return fs;
+}
+
+
+int LogIndex::Open(const std::string &_logFile, const std::string &_indexFile, uint64_t _configHash)
+{
+	Flush();
+
+	logFile = _logFile;
+	indexFile = _indexFile;
+	configHash = _configHash;
+
+	entries.clear();
+	nSaved = 0;
+	end = 0;
+	savedEnd = -1;
+	hint = 0;
+
+	std::ifstream ifs(indexFile, std::ios::binary);
+	Header header;
+
+	if(!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)))
+		return 0;
+
+	const FileStatus fs = GetFileStatus(logFile);
+
+	// Validate the index against the current log file
+	if(std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0 ||
+	   header.configHash != configHash ||
+	   header.inode != fs.inode ||
+	   std::streamoff(header.end) > fs.size ||
+	   (std::streamoff(header.end) == fs.size && header.mtime != fs.mtime) ||
+	   header.tailHash != TailHash(std::streamoff(header.end)))
+	{
+		return 0;
+	}
+
+	entries.resize(size_t(header.nEntries));
+
+	if(!ifs.read(reinterpret_cast<char*>(entries.data()), std::streamsize(entries.size() * sizeof(Entry))))
+	{
+		entries.clear();
+		return 0;
+	}
+
+	nSaved = entries.size();
+	end = savedEnd = std::streamoff(header.end);
+
+	return int(entries.size());
+}
+
+
+int LogIndex::Flush()
+{
+	if(indexFile.empty() || end == savedEnd)
+		return 0;
+
+	std::fstream ofs;
+
+	if(nSaved > 0)
+		ofs.open(indexFile, std::ios::binary | std::ios::in | std::ios::out);
+
+	if(!ofs.is_open()) {
+		ofs.open(indexFile, std::ios::binary | std::ios::out | std::ios::trunc);
+		nSaved = 0;
+	}
+
+	if(!ofs.is_open())
+		return err_cannotWrite;
+
+	const FileStatus fs = GetFileStatus(logFile);
+
+	Header header;
+	std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+	header.configHash = configHash;
+	header.inode = fs.inode;
+	header.mtime = (fs.size == end) ? fs.mtime : 0;
+	header.end = uint64_t(end);
+	header.tailHash = TailHash(end);
+	header.nEntries = entries.size();
+
+	// New entries first, then the header that makes them valid
+	ofs.seekp(std::streamoff(sizeof(Header) + nSaved * sizeof(Entry)));
+	ofs.write(reinterpret_cast<const char*>(entries.data() + nSaved), std::streamsize((entries.size() - nSaved) * sizeof(Entry)));
+	ofs.seekp(0);
+	ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	if(!ofs.good())
+		return err_cannotWrite;
+
+	nSaved = entries.size();
+	savedEnd = end;
+
+	return int(nSaved);
+}
+
+
+size_t LogIndex::Find(std::streamoff _offset) const
+{
+	if(_offset >= end || entries.empty())
+		return npos;
+
+	// Sequential reading: check the entry after the last one found
+	if(hint < entries.size() && entries[hint].Offset() == _offset)
+		return hint++;
+
+	const auto it = std::lower_bound(entries.begin(), entries.end(), _offset,
+	                                 [](const Entry &e, std::streamoff off) { return e.Offset() < off; });
+
+	if(it == entries.end() || it->Offset() != _offset)
+		return npos;
+
+	hint = size_t(it - entries.begin()) + 1;
+	return hint - 1;
+}
+
+
+bool LogIndex::Append(std::streamoff _offset, std::streamoff _end, int _level, int64_t _timestamp)
+{
+	if(indexFile.empty() || _offset != end)
+		return false;
+
+	// A log without a level is indexed too, or the index could not grow past it
+	Entry e;
+	e.offsetLevel = (uint64_t(_offset) << 16) | (_level < 0 ? unknownLevel : uint64_t(_level) & 0xFFFF);
+	e.timestamp = _timestamp;
+
+	entries.push_back(e);
+	end = _end;
+
+	return true;
+}
+
+
+bool LogIndex::Extend(std::streamoff _offset, std::streamoff _end)
+{
+	if(indexFile.empty() || _offset != end)
+		return false;
+
+	end = _end;
+	return true;
+}
+
+
+std::streamoff LogIndex::FindLatestLogs(int _nLogs, std::streamoff _fileSize) const
+{
+	if(indexFile.empty() || end != _fileSize)
+		return -1;
+
+	if(size_t(_nLogs) >= entries.size())
+		return 0;
+
+	return entries[entries.size() - size_t(_nLogs)].Offset();
+}
+
+
+std::string LogIndex::IndexFileName(const std::string &_logFile, const std::string &_indexDir)
+{
+	if(_indexDir.empty())
+		return _logFile + ".lvidx";
+
+	// In a shared directory, tell apart log files with the same name
+	const size_t slash = _logFile.find_last_of("\\/");
+	const std::string baseName = (slash == std::string::npos) ? _logFile : _logFile.substr(slash + 1);
+
+	char hash[20];
+	std::snprintf(hash, sizeof(hash), "%08x", unsigned(Hash(_logFile.data(), _logFile.size())));
+
+	return _indexDir + "/" + baseName + "." + hash + ".lvidx";
+}
+
+
+// FNV-1a
+
+uint64_t LogIndex::Hash(const void *_data, size_t _size, uint64_t _hash)
+{
+	const unsigned char *p = static_cast<const unsigned char*>(_data);
+
+	for(size_t i = 0; i < _size; ++i) {
+		_hash ^= p[i];
+		_hash *= 1099511628211ULL;
+	}
+
+	return _hash;
+}
+
+
+uint64_t LogIndex::TailHash(std::streamoff _end) const
+{
+	const std::streamoff begin = std::max(std::streamoff(0), _end - std::streamoff(tailHashSize));
+	char buf[tailHashSize];
+
+	std::ifstream ifs(logFile, std::ios::binary);
+	ifs.seekg(begin);
+	ifs.read(buf, _end - begin);
+
+	return Hash(buf, size_t(ifs.gcount()));
+}
+
+
+} // log_viewer
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * LogIndex.hpp
+ *
+ * Persistent sidecar index of a log file: offset, level and timestamp of
+ * each log, to reload and filter old logs without parsing them again.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef LOG_INDEX_HPP
+#define LOG_INDEX_HPP
+
+#include <cstdint>
+#include <ios>
+#include <string>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class LogIndex
+{
+	/** Index file layout (native byte order):
+	 *		Header
+	 *		Entry[nEntries]
+	 *
+	 *	The index is valid for a log file with the same inode, a size not smaller
+	 *	than the indexed one, the same bytes just before the end of the indexed
+	 *	part, and the same modification time if the size has not changed.
+	 *	It is also bound to the log levels configuration and the options of the level
+	 *	search, such as the learned level position (configHash).
+	 *	The entries cover the log file from its beginning, without gaps.
+	 */
+
+public:
+	struct Entry
+	{
+		uint64_t  offsetLevel;		// offset of the log in the file (48 bits) | level (16 bits)
+		int64_t   timestamp;		// milliseconds, noTimestamp if not available
+
+		std::streamoff Offset() const { return std::streamoff(offsetLevel >> 16); }
+		int            Level()  const { return (offsetLevel & 0xFFFF) == unknownLevel ? -1 : int(offsetLevel & 0xFFFF); }
+	};
+
+	static constexpr uint64_t unknownLevel = 0xFFFF;		// stored for a log without a level, e.g. an unknown tag at --levelCol
+
+	static const size_t npos = size_t(-1);
+
+	static const int err_cannotWrite = -1;
+
+	~LogIndex() { Flush(); }
+
+	// Load the index of _logFile from _indexFile, discarding it if not valid; return the number of entries
+	int  Open(const std::string &_logFile, const std::string &_indexFile, uint64_t _configHash);
+	int  Flush();			// save the new entries
+	bool IsOpen() const { return !indexFile.empty(); }
+
+	size_t         Size() const { return entries.size(); }
+	std::streamoff End()  const { return end; }			// end of the indexed part of the log file
+	const Entry&   operator[](size_t _i) const { return entries[_i]; }
+
+	// Entry of the log at _offset; npos if not indexed
+	size_t Find(std::streamoff _offset) const;
+
+	// Add the log in [_offset, _end), if it directly follows the indexed part; a negative _level is unknown
+	bool Append(std::streamoff _offset, std::streamoff _end, int _level, int64_t _timestamp);
+	// Extend the indexed part over a block without logs (e.g. an empty line)
+	bool Extend(std::streamoff _offset, std::streamoff _end);
+
+	// Offset of the first of the latest _nLogs logs; -1 if the index does not reach _fileSize
+	std::streamoff FindLatestLogs(int _nLogs, std::streamoff _fileSize) const;
+
+	// Default file name: next to the log file, or in _indexDir
+	static std::string IndexFileName(const std::string &_logFile, const std::string &_indexDir);
+
+	static uint64_t Hash(const void *_data, size_t _size, uint64_t _hash = 14695981039346656037ULL);
+
+private:
+	struct Header
+	{
+		char      magic[8];
+		uint64_t  configHash;
+		uint64_t  inode;
+		int64_t   mtime;			// 0 if the file kept growing after the index was saved
+		uint64_t  end;				// end of the indexed part of the log file
+		uint64_t  tailHash;			// hash of the bytes just before end
+		uint64_t  nEntries;
+	};
+
+	uint64_t TailHash(std::streamoff _end) const;
+
+	std::string  logFile, indexFile;
+	uint64_t     configHash = 0;
+
+	std::vector<Entry>  entries;
+	size_t          nSaved = 0;				// entries already in the index file
+	std::streamoff  end = 0;
+	std::streamoff  savedEnd = -1;
+	mutable size_t  hint = 0;				// entry after the last one found
+};
+
+
+} // log_viewer
+
+
+#endif // LOG_INDEX_HPP
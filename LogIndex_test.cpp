@@ -0,0 +1,76 @@
+/// LogIndex_test.cpp
+
+/**
+	Test of the log_viewer::LogIndex class: logs without a level, e.g. an
+	unknown tag at --levelCol, are indexed as well, and the index keeps
+	growing after them.
+ */
+
+#ifdef LOGINDEX_TEST
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include "LogIndex.hpp"
+
+
+int LogIndex_test()
+{
+	using namespace std;
+	using namespace log_viewer;
+
+	const string logFile = "LogIndex_test.log";
+	const string indexFile = LogIndex::IndexFileName(logFile, "");
+	const int levels[] = { 2, -1, 3, -1, 0, 5 };
+	const int nLogs = int(sizeof(levels) / sizeof(levels[0]));
+
+	int nErrors = 0;
+
+	const auto check = [&](bool _ok, const char *_what) {
+		if(_ok == false) {
+			cout << "LogIndex test: " << _what << " - FAILED" << endl;
+			++nErrors;
+		}
+	};
+
+	{
+		ofstream ofs(logFile, ios::trunc);
+		for(int i = 0; i < nLogs; ++i)
+			ofs << "log " << i << endl;		// 6 bytes each
+	}
+
+	remove(indexFile.c_str());
+
+	{
+		LogIndex index;
+		index.Open(logFile, indexFile, 1);
+
+		for(int i = 0; i < nLogs; ++i)
+			check(index.Append(6 * i, 6 * (i + 1), levels[i], i), "a log is appended, with or without a level");
+
+		check(index.Size() == size_t(nLogs), "all the logs indexed");
+		check(index.End() == 6 * nLogs, "the index reaches the end of the file");
+	}
+
+	// Saved and loaded again, with the unknown levels still unknown
+	{
+		LogIndex index;
+		check(index.Open(logFile, indexFile, 1) == nLogs, "index loaded");
+
+		for(int i = 0; i < nLogs && i < int(index.Size()); ++i) {
+			check(index[i].Level() == levels[i], "level of a log");
+			check(index[i].Offset() == 6 * i, "offset of a log");
+			check(index.Find(6 * i) == size_t(i), "log found by its offset");
+		}
+	}
+
+	remove(logFile.c_str());
+	remove(indexFile.c_str());
+
+	cout << "LogIndex test: " << nErrors << " errors" << endl;
+
+	return nErrors;
+}
+
+#endif // LOGINDEX_TEST
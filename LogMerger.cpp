@@ -0,0 +1,507 @@
+/******************************************************************************
+ * LogMerger.cpp
+ *
+ * Follow several log files at once, merging their logs in time order.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "LogMerger.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <glob.h>
+#endif
+
+#include <sys/stat.h>
+
+
+namespace log_viewer {
+
+
+int LogMerger::AddSource(const std::string &_fileName, const std::string &_readerType)
+{
+	Source src;
+	src.fileName = _fileName;
+	src.reader.reset(LogReader::Create(_readerType, _fileName));
+
+	if(!src.reader)
+		return -1;
+
+	src.reader->SetMaxLineSize(maxLineSize);
+	src.reader->SetHoldPartial(holdPartial);
+
+	const int r = src.reader->Open(_fileName);
+
+	// Reuse the slot of a dropped file
+	size_t i = sources.size();
+
+	if(freeSlots.empty()) {
+		sources.push_back(std::move(src));
+	}
+	else {
+		i = freeSlots.back();
+		freeSlots.pop_back();
+		sources[i] = std::move(src);
+	}
+
+	byName[_fileName] = i;
+	++nActive;
+
+	return r;
+}
+
+
+int LogMerger::AddPattern(const std::string &_pattern, const std::string &_readerType)
+{
+	patterns.push_back(Pattern{ _pattern, _readerType });
+	return Scan(patterns.back(), false);
+}
+
+
+int LogMerger::Rescan()
+{
+	int n = 0;
+
+	for(const Pattern &p : patterns)
+		n += Scan(p, true);
+
+	return n;
+}
+
+
+std::vector<std::string> LogMerger::Dirs() const
+{
+	std::vector<std::string> dirs;
+
+	for(const Pattern &p : patterns)
+	{
+		const size_t slash = p.pattern.rfind('/');
+		const std::string dir = (slash == std::string::npos) ? "" : p.pattern.substr(0, slash + 1);
+
+		if(IsPattern(dir) == false && std::find(dirs.begin(), dirs.end(), dir) == dirs.end())
+			dirs.push_back(dir);
+	}
+
+	return dirs;
+}
+
+
+void LogMerger::Wake(const std::string &_fileName)
+{
+	const auto it = byName.find(_fileName);
+
+	if(it != byName.end())
+		sources[it->second].activity.Wake();
+}
+
+
+/// Add the regular files matching a pattern and not followed yet
+
+int LogMerger::Scan(const Pattern &_pattern, bool _announce)
+{
+	std::vector<std::string> names;
+
+#ifdef POSIX
+	glob_t g;
+
+	if(glob(_pattern.pattern.c_str(), 0, nullptr, &g) == 0)
+		names.assign(g.gl_pathv, g.gl_pathv + g.gl_pathc);
+
+	globfree(&g);
+#else
+	names.push_back(_pattern.pattern);
+#endif
+
+	bases.insert(names.begin(), names.end());
+
+	int n = 0;
+
+	for(const std::string &name : names)
+	{
+		if(byName.count(name) > 0 || RotatedCopy(name))
+			continue;
+
+		struct stat st;
+
+		if(stat(name.c_str(), &st) != 0 || (st.st_mode & S_IFMT) != S_IFREG)
+			continue;
+
+		// A matched file renamed to another matching name (e.g. written aside, then moved in place) is not read again
+		const size_t i = Renamed(uint64_t(st.st_ino));
+
+		if(i < sources.size()) {
+			byName.erase(sources[i].fileName);
+			sources[i].fileName = name;
+			byName[name] = i;
+			continue;
+		}
+
+		if(AddSource(name, _pattern.readerType) != 0)
+			std::cerr << "logviewer: warning: cannot open the log file: " << name << std::endl;
+
+		sources[byName[name]].matched = true;
+
+		if(_announce)
+			Notice("--- LOG FILE ADDED: " + name + " ---");
+
+		++n;
+	}
+
+	return n;
+}
+
+
+/// The matched file with this inode, no longer found by its name; sources.size() if none
+
+size_t LogMerger::Renamed(uint64_t _inode) const
+{
+	struct stat st;
+
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		const Source &src = sources[i];
+
+		if(src.matched == false || src.dropped ||
+		   (src.parked ? src.parkedInode : src.reader->Inode()) != _inode)
+			continue;
+
+		if(stat(src.fileName.c_str(), &st) != 0 || uint64_t(st.st_ino) != _inode)
+			return i;
+	}
+
+	return sources.size();
+}
+
+
+/// A rotated copy of a matched file, e.g. app.log.1 or app.log-20190105.gz of app.log
+
+bool LogMerger::RotatedCopy(const std::string &_name) const
+{
+	const size_t slash = _name.rfind('/');
+	size_t sep = (slash == std::string::npos) ? 0 : slash + 1;
+
+	while((sep = _name.find_first_of(".-_", sep + 1)) != std::string::npos)
+	{
+		if(bases.count(_name.substr(0, sep)) > 0 && LogReader::IsRotationSuffix(_name.substr(sep + 1)))
+			return true;
+	}
+
+	return false;
+}
+
+
+int LogMerger::CheckFiles()
+{
+	int n = 0;
+	rotationPending = false;
+
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		Source &src = sources[i];
+
+		if(src.dropped)
+			continue;
+
+		LogReader &reader = *src.reader;
+
+		if(src.parked)
+		{
+			if(src.activity.Changed(src.fileName) == false) {
+				src.due = false;
+				continue;
+			}
+
+			Unpark(src);
+		}
+
+		// A file read to its end, and unchanged since, is left alone;
+		// CheckFile() still has to see each new position, to detect a truncation
+		src.due = src.drained == false || reader.Tell() != src.checkedPos ||
+		          reader.Seekable() == false || src.activity.Changed(src.fileName);
+
+		if(src.due == false)
+		{
+			// Too many files open: close the quiet ones
+			if(nActive > maxOpen && reader.IsOpen() && reader.Seekable() && src.pending.empty() && src.activity.Hot() == false)
+				Park(src);
+
+			continue;
+		}
+
+		src.checkedPos = reader.Tell();
+
+		const int fileChange = reader.CheckFile(src.fileName);
+
+		if(fileChange == LogReader::file_rotated)
+		{
+			// First read the old file to its end, including a last line without new line
+			if(reader.IsOpen() && reader.Tell() < reader.Size()) {
+				reader.SetHoldPartial(false);
+				rotationPending = true;
+				src.activity.Invalidate();		// check the new file again at the next round
+				continue;
+			}
+
+			if(reader.IsOpen())
+				Notice("--- LOG FILE ROTATED: " + src.fileName + " ---");
+
+			reader.Close();
+			reader.SetHoldPartial(holdPartial);
+
+			if(reader.Open(src.fileName) == 0)
+				++n;
+		}
+		else if(fileChange == LogReader::file_truncated)
+		{
+			Notice("--- LOG FILE TRUNCATED: " + src.fileName + " ---");
+			reader.Seek(0);
+			++n;
+		}
+		else if(fileChange == LogReader::file_missing && src.matched)
+		{
+			// Deleted: dropped once read to its end, including a last line without new line
+			reader.SetHoldPartial(false);
+
+			if(src.pending.empty() && (reader.IsOpen() == false || reader.Tell() >= reader.Size()))
+				Drop(i);
+		}
+	}
+
+	return n;
+}
+
+
+int LogMerger::Read()
+{
+	int n = 0;
+	const Clock::time_point now = Clock::now();
+
+	for(size_t i = 0; i < sources.size(); ++i)
+	{
+		if(sources[i].dropped == false && sources[i].due)
+			n += Fill(i, now);
+	}
+
+	return n;
+}
+
+
+/// Queue the lines of a file, up to maxPending; return the number of lines read
+
+int LogMerger::Fill(size_t _source, Clock::time_point _now)
+{
+	Source &src = sources[_source];
+	int n = 0;
+	std::string_view line;
+
+	// A missing file is waited for like an idle one
+	if(src.reader->IsOpen() == false) {
+		src.drained = true;
+		return 0;
+	}
+
+	const bool wasEmpty = src.pending.empty();
+	src.drained = false;
+
+	while(src.pending.size() < maxPending)
+	{
+		if(src.reader->GetLine(line) == false) {
+			src.drained = true;
+			break;
+		}
+
+		if(line.empty())
+			continue;
+
+		int64_t timestamp = ParseTimestamp(line);
+
+		if(timestamp == noTimestamp)
+			timestamp = src.lastTimestamp;
+		else
+			src.lastTimestamp = timestamp;
+
+		if(timestamp > newestTimestamp)
+			newestTimestamp = timestamp;
+
+		std::string text(line);
+
+		if(src.reader->Truncated() > 0)
+			text.append(LogReader::CutMarker(src.reader->Truncated()));
+
+		src.pending.push_back(Pending{ std::move(text), timestamp, seq++, _now });
+		++n;
+	}
+
+	src.reader->Clear();		// clear the eof state to keep reading the growing file
+
+	if(wasEmpty && src.pending.empty() == false)
+		PushHead(_source);
+
+	return n;
+}
+
+
+/// Every file has pending lines, or has been read to its end
+
+bool LogMerger::AllRead() const
+{
+	for(const Source &src : sources)
+		if(src.dropped == false && src.pending.empty() && src.drained == false)
+			return false;
+
+	return true;
+}
+
+
+bool LogMerger::Next(Line &_line)
+{
+	if(heap.empty())
+		return false;
+
+	const HeapItem top = heap.top();
+	Source &src = sources[top.source];
+	Pending &p = src.pending.front();
+
+	// A file with lines still to read may hold older ones: the window waits only for the idle files
+	const bool release = heap.size() == nActive ||
+	                     top.timestamp == noTimestamp ||
+	                     (AllRead() && (top.timestamp <= newestTimestamp - window.count() ||
+	                                    Clock::now() - p.arrival >= window));
+
+	if(release == false)
+		return false;
+
+	heap.pop();
+
+	_line.text.swap(p.text);
+	_line.timestamp = p.timestamp;
+	_line.source = top.source;
+
+	src.pending.pop_front();
+
+	// A file stopped at maxPending is read again before its next line is compared
+	if(src.pending.empty() == false)
+		PushHead(top.source);
+	else if(src.drained == false)
+		Fill(top.source, Clock::now());
+
+	return true;
+}
+
+
+std::chrono::milliseconds LogMerger::TimeToNext() const
+{
+	if(heap.empty())
+		return std::chrono::milliseconds::max();
+
+	const Pending &p = sources[heap.top().source].pending.front();
+	const auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - p.arrival);
+
+	return waited >= window ? std::chrono::milliseconds(0) : window - waited;
+}
+
+
+void LogMerger::Activity(size_t &_hot, size_t &_cold) const
+{
+	_hot = _cold = 0;
+
+	for(const Source &src : sources)
+		if(src.dropped == false)
+			++(src.activity.Hot() ? _hot : _cold);
+}
+
+
+void LogMerger::Discard()
+{
+	for(Source &src : sources)
+	{
+		if(src.dropped)
+			continue;
+
+		if(src.parked)
+			Unpark(src);			// the readers are moved: they must be open
+
+		src.pending.clear();
+		src.drained = false;		// the readers are moved: read them again
+	}
+
+	heap = decltype(heap)();
+}
+
+
+/// Close a quiet file, keeping its position and identity
+
+void LogMerger::Park(Source &_src)
+{
+	_src.parkedPos = _src.reader->Tell();
+	_src.parkedInode = _src.reader->Inode();
+	_src.reader->Close();
+	_src.parked = true;
+}
+
+
+/// Reopen a parked file where it was left; a file replaced meanwhile is read from its beginning
+
+void LogMerger::Unpark(Source &_src)
+{
+	LogReader &reader = *_src.reader;
+
+	_src.parked = false;
+	_src.drained = false;
+
+	if(reader.Open(_src.fileName) != 0)
+		return;		// deleted: CheckFile() tells
+
+	struct stat st;
+
+	if(stat(_src.fileName.c_str(), &st) != 0 || uint64_t(st.st_ino) != _src.parkedInode)
+		Notice("--- LOG FILE ROTATED: " + _src.fileName + " ---");
+	else if(reader.Size() < _src.parkedPos)
+		Notice("--- LOG FILE TRUNCATED: " + _src.fileName + " ---");
+	else
+		reader.Seek(_src.parkedPos);
+}
+
+
+void LogMerger::Drop(size_t _i)
+{
+	Source &src = sources[_i];
+
+	Notice("--- LOG FILE REMOVED: " + src.fileName + " ---");
+
+	byName.erase(src.fileName);
+	src.reader.reset();
+	src.dropped = true;
+
+	freeSlots.push_back(_i);
+	--nActive;
+}
+
+
+void LogMerger::Notice(const std::string &_notice) const
+{
+	if(notify)
+		notify(_notice);
+	else
+		std::cout << _notice << std::endl;
+}
+
+
+void LogMerger::PushHead(size_t _source)
+{
+	const Pending &p = sources[_source].pending.front();
+	heap.push(HeapItem{ p.timestamp, p.seq, _source });
+}
+
+
+} // log_viewer
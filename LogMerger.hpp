@@ -0,0 +1,199 @@
+/******************************************************************************
+ * LogMerger.hpp
+ *
+ * Follow several log files at once, merging their logs in time order.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef LOG_MERGER_HPP
+#define LOG_MERGER_HPP
+
+#include "FileWatcher.hpp"
+#include "LogReader.hpp"
+#include "Timestamp.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class LogMerger
+{
+	/** k-way merge on the timestamps of the logs.
+	 *
+	 *	Each file is read in its own order into a queue of pending lines; a min-heap
+	 *	holds the first pending line of each file. Up to maxPending lines are read
+	 *	in advance; a file whose queue empties is read again at once. The oldest line
+	 *	is released when:
+	 *		- all the files have pending lines, so no older line can arrive;
+	 *		- or the files without pending lines have been read to their end, and
+	 *		  it is older than the newest timestamp read minus the reorder window,
+	 *		  or it has been waiting for longer than the reorder window.
+	 *	The window bounds both the clock skew among the sources and the display delay;
+	 *	with a window of 0, e.g. for a one-shot scan, a file read to its end is not
+	 *	waited for.
+	 *	Lines without a timestamp (e.g. the continuation of a multi-line log) take
+	 *	the timestamp of the previous line of the same file.
+	 *	A file read to its end is read again only when its size, time or inode
+	 *	change (see FileActivity): idle files cost a stat(), less and less often.
+	 *	With more than maxOpen files, the quiet ones are parked: closed, with
+	 *	their position and inode kept, and reopened when they change.
+	 *	Files matching a pattern (e.g. *.log in a directory) are added by Rescan()
+	 *	as they appear, and dropped once deleted and read to their end; the
+	 *	rotated copies of the matched files (app.log.1, app.log.2.gz) are skipped.
+	 */
+
+public:
+	typedef std::chrono::steady_clock  Clock;
+
+	struct Line
+	{
+		std::string  text;
+		int64_t      timestamp = noTimestamp;
+		size_t       source = 0;			// index of the file
+	};
+
+	static const size_t maxPending = 1024;	// lines read in advance from each file
+	static const size_t maxOpen = 64;		// files kept open; beyond, the quiet ones are parked
+
+	// Add a file to the merge; it is opened now, or as soon as it appears
+	int  AddSource(const std::string &_fileName, const std::string &_readerType);
+
+	// Add the files matching a pattern, and the ones matching it later at each Rescan(); return the number of files added
+	int  AddPattern(const std::string &_pattern, const std::string &_readerType);
+	int  Rescan();		// add the new files matching the patterns; return their number
+
+	static bool IsPattern(const std::string &_name) { return _name.find_first_of("*?[") != std::string::npos; }
+
+	// Directories of the patterns, with their final slash ("" for the current one); the ones with wildcards are excluded
+	std::vector<std::string> Dirs() const;
+
+	size_t              NSources() const            { return sources.size(); }		// including dropped files
+	bool                Dropped(size_t _i) const    { return sources[_i].dropped; }
+	const std::string&  FileName(size_t _i) const   { return sources[_i].fileName; }
+	LogReader&          Reader(size_t _i)           { return *sources[_i].reader; }
+
+	void SetWindow(std::chrono::milliseconds _window) { window = _window; }
+	std::chrono::milliseconds Window() const          { return window; }
+
+	// Lines longer than _size bytes are truncated, with a marker (0: no limit); for the files added from now on
+	void SetMaxLineSize(size_t _size)                 { maxLineSize = _size; }
+
+	// Hold the partial last line of a file until its new line arrives (see LogReader); for the files added from now on
+	void SetHoldPartial(bool _hold)                   { holdPartial = _hold; }
+
+	// Receives the notices of files added, rotated, truncated, removed (default: printed on the standard output)
+	typedef std::function<void(const std::string &_notice)>  Notify;
+	void SetNotify(Notify _notify)                    { notify = _notify; }
+
+	// Follow the files by name, across rotations and truncations; return the number of files reopened or rewound
+	int  CheckFiles();
+	void Wake(const std::string &_fileName);	// a file event: check the file in this round
+
+	// Files changed recently, and files backed off
+	void Activity(size_t &_hot, size_t &_cold) const;
+	bool RotationPending() const { return rotationPending; }	// an old file is still being read to its end
+
+	// Read the available lines of the files; return the number of lines read
+	int  Read();
+
+	// Next line in time order, if it can be released now
+	bool Next(Line &_line);
+
+	// Time before the oldest pending line is released by the reorder window
+	std::chrono::milliseconds TimeToNext() const;
+
+	// Drop the pending lines, e.g. before moving the readers
+	void Discard();
+
+private:
+	struct Pending
+	{
+		std::string        text;
+		int64_t            timestamp;
+		uint64_t           seq;				// reading order, to keep equal timestamps stable
+		Clock::time_point  arrival;
+	};
+
+	struct Source
+	{
+		std::string                 fileName;
+		std::unique_ptr<LogReader>  reader;
+		std::deque<Pending>         pending;
+		int64_t                     lastTimestamp = noTimestamp;
+		FileActivity                activity;
+		bool                        due = true;			// to be read in this round
+		bool                        drained = false;	// read to its end at the last round
+		std::streamoff              checkedPos = -1;	// position at the last CheckFile()
+		bool                        matched = false;	// added by a pattern: dropped when deleted
+		bool                        dropped = false;	// slot free
+		bool                        parked = false;		// closed while quiet
+		std::streamoff              parkedPos = 0;
+		uint64_t                    parkedInode = 0;
+	};
+
+	struct Pattern
+	{
+		std::string  pattern;
+		std::string  readerType;
+	};
+
+	struct HeapItem
+	{
+		int64_t   timestamp;
+		uint64_t  seq;
+		size_t    source;
+
+		bool operator>(const HeapItem &_h) const {
+			return timestamp != _h.timestamp ? timestamp > _h.timestamp : seq > _h.seq;
+		}
+	};
+
+	int  Fill(size_t _source, Clock::time_point _now);
+	bool AllRead() const;		// every file has pending lines, or has been read to its end
+	void PushHead(size_t _source);
+	void Notice(const std::string &_notice) const;
+	int  Scan(const Pattern &_pattern, bool _announce);
+	void Park(Source &_src);
+	void Unpark(Source &_src);
+	void Drop(size_t _i);
+	bool RotatedCopy(const std::string &_name) const;
+	size_t Renamed(uint64_t _inode) const;
+
+	std::vector<Source>  sources;
+	std::vector<Pattern> patterns;
+	std::unordered_map<std::string, size_t>  byName;	// files followed, and their sources
+	std::unordered_set<std::string>  bases;			// names ever matched, whose rotated copies are skipped
+	std::vector<size_t>  freeSlots;					// of the dropped sources
+	size_t    nActive = 0;							// sources not dropped
+	std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<HeapItem>>  heap;	// first pending line of each file
+
+	std::chrono::milliseconds  window = std::chrono::milliseconds(500);
+	size_t    maxLineSize = 0;
+	bool      holdPartial = false;
+	Notify    notify;
+	int64_t   newestTimestamp = noTimestamp;
+	uint64_t  seq = 0;
+	bool      rotationPending = false;
+};
+
+
+} // log_viewer
+
+
+#endif // LOG_MERGER_HPP
@@ -0,0 +1,243 @@
+/// LogMerger_test.cpp
+
+/**
+	Test of the log_viewer::LogMerger class: order of the logs of several
+	files, and the rules releasing them (all the files have pending logs,
+	reorder window, timeout, logs without timestamp), with logs arriving
+	late inside and outside the window.
+ */
+
+#ifdef LOGMERGER_TEST
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LogMerger.hpp"
+
+
+namespace {
+
+using namespace std;
+using namespace log_viewer;
+
+const char *files[] = { "LogMerger_test_a.log", "LogMerger_test_b.log", "LogMerger_test_c.log" };
+
+
+void Write(int _file, const string &_text, bool _append = true)
+{
+	ofstream ofs(files[_file], _append ? ios::app : ios::trunc);
+	ofs << _text;
+}
+
+
+// A round of the main loop, after file events on all the files
+void Round(LogMerger &_merger)
+{
+	for(size_t i = 0; i < _merger.NSources(); ++i)
+		_merger.Wake(_merger.FileName(i));
+
+	_merger.CheckFiles();
+	_merger.Read();
+}
+
+
+// The lines that can be released now, without their timestamps
+string Released(LogMerger &_merger)
+{
+	string lines;
+	LogMerger::Line line;
+
+	while(_merger.Next(line))
+		lines += line.text.substr(line.text.find(' ') + 1) + "|";
+
+	return lines;
+}
+
+
+void Wait(chrono::milliseconds _window)
+{
+	this_thread::sleep_for(_window + chrono::milliseconds(50));
+}
+
+
+// A timestamp _seconds after the start of 2019, within its first day
+string Stamp(int _seconds)
+{
+	char stamp[32];
+	snprintf(stamp, sizeof(stamp), "2019-01-01T%02d:%02d:%02dZ", _seconds / 3600, _seconds / 60 % 60, _seconds % 60);
+	return stamp;
+}
+
+
+// Release the lines that can be released now, reading the files again as the main loop
+// does, until they have no more lines; false if one is older than the previous one
+bool ReleaseInOrder(LogMerger &_merger, size_t &_nLines, int64_t &_last)
+{
+	bool ordered = true;
+	LogMerger::Line line;
+
+	do {
+		while(_merger.Next(line)) {
+			ordered = ordered && line.timestamp >= _last;
+			_last = line.timestamp;
+			++_nLines;
+		}
+	} while(_merger.Read() > 0);
+
+	return ordered;
+}
+
+} // anonymous
+
+
+int LogMerger_test()
+{
+	const chrono::milliseconds window(300);
+	int nErrors = 0;
+
+	const auto check = [&](const string &_released, const string &_expected, const char *_what) {
+		if(_released != _expected) {
+			cout << "LogMerger test: " << _what << ": \"" << _released << "\" instead of \"" << _expected << "\" - FAILED" << endl;
+			++nErrors;
+		}
+	};
+
+	// Three files, interleaved: time order, equal timestamps in reading order, empty lines skipped,
+	// a line without timestamp after the log it continues
+	{
+		Write(0, "2019-01-01T10:00:01Z a1\n\n2019-01-01T10:00:04Z a2\n\tat a2-continued\n", false);
+		Write(1, "2019-01-01T10:00:02Z b1\n2019-01-01T10:00:05Z b2\n", false);
+		Write(2, "2019-01-01T10:00:03Z c1\n2019-01-01T10:00:04Z c2\n", false);
+
+		LogMerger merger;
+		merger.SetWindow(window);
+		for(const char *f : files)
+			merger.AddSource(f, "stream");
+
+		Round(merger);
+		check(Released(merger), "a1|b1|c1|a2|a2-continued|c2|", "order across the files");
+
+		// The newest line may still be preceded by an older one, within the window: it waits for it
+		Wait(window);
+		check(Released(merger), "b2|", "newest line released after the window");
+	}
+
+	// A late line inside the window is put in its place
+	{
+		Write(0, "2019-01-01T10:00:10Z a1\n", false);
+		Write(1, "", false);
+
+		LogMerger merger;
+		merger.SetWindow(window);
+		merger.AddSource(files[0], "stream");
+		merger.AddSource(files[1], "stream");
+
+		Round(merger);
+		check(Released(merger), "", "waiting for the other file");
+
+		Write(1, "2019-01-01T10:00:09.900Z b-late\n");
+		Round(merger);
+		check(Released(merger), "b-late|", "late line inside the window");
+
+		Wait(window);
+		check(Released(merger), "a1|", "line released after the window");
+	}
+
+	// A late line outside the window follows the newer lines already released
+	{
+		Write(0, "2019-01-01T10:00:10Z a1\n2019-01-01T10:00:12Z a2\n", false);
+		Write(1, "", false);
+
+		LogMerger merger;
+		merger.SetWindow(window);
+		merger.AddSource(files[0], "stream");
+		merger.AddSource(files[1], "stream");
+
+		Round(merger);
+		check(Released(merger), "a1|", "line older than the newest minus the window");
+
+		Write(1, "2019-01-01T10:00:09Z b-late\n");
+		Round(merger);
+		check(Released(merger), "b-late|", "late line outside the window");
+
+		Wait(window);
+		check(Released(merger), "a2|", "line released after the window");
+	}
+
+	// A line without timestamp, and none before it in its file, is released at once
+	{
+		Write(0, "- no-timestamp\n", false);
+		Write(1, "", false);
+
+		LogMerger merger;
+		merger.SetWindow(window);
+		merger.AddSource(files[0], "stream");
+		merger.AddSource(files[1], "stream");
+
+		Round(merger);
+		check(Released(merger), "no-timestamp|", "line without timestamp");
+	}
+
+	// Across years and time zones: the same instant written in different ways
+	{
+		Write(0, "2018-12-31T23:59:58Z a1\n2019-01-01T01:00:01+01:00 a2\n", false);
+		Write(1, "2018-12-31T18:59:59-05:00 b1\n2019-01-01T00:00:02Z b2\n", false);
+
+		LogMerger merger;
+		merger.SetWindow(window);
+		merger.AddSource(files[0], "stream");
+		merger.AddSource(files[1], "stream");
+
+		Round(merger);
+		Wait(window);
+		check(Released(merger), "a1|b1|a2|b2|", "order across years and time zones");
+	}
+
+	// Files longer than maxPending, with logs at different rates: a file is read again
+	// when its queue empties, before any newer line of the others is released;
+	// also with a window of 0, as for a one-shot scan
+	for(const chrono::milliseconds w : { window, chrono::milliseconds(0) })
+	{
+		const int nLines = 3 * int(LogMerger::maxPending);
+		string a, b;
+
+		for(int i = 0; i < nLines; ++i) {
+			a += Stamp(i) + " a" + to_string(i) + "\n";
+			b += Stamp(7 * i) + " b" + to_string(i) + "\n";
+		}
+
+		Write(0, a, false);
+		Write(1, b, false);
+
+		LogMerger merger;
+		merger.SetWindow(w);
+		merger.AddSource(files[0], "stream");
+		merger.AddSource(files[1], "stream");
+
+		size_t nReleased = 0;
+		int64_t last = noTimestamp;
+		bool ordered = true;
+
+		Round(merger);
+		ordered = ReleaseInOrder(merger, nReleased, last) && ordered;
+		Wait(w);
+		Round(merger);
+		ordered = ReleaseInOrder(merger, nReleased, last) && ordered;
+
+		check(ordered ? "ordered" : "out of order", "ordered", "files longer than maxPending");
+		check(to_string(nReleased), to_string(2 * nLines), "files longer than maxPending, lines released");
+	}
+
+	for(const char *f : files)
+		remove(f);
+
+	cout << "LogMerger test: " << nErrors << " errors" << endl;
+
+	return nErrors;
+}
+
+#endif // LOGMERGER_TEST
@@ -0,0 +1,138 @@
+/******************************************************************************
+ * LogPipeline.cpp
+ *
+ * Staged processing of the logs: the reading thread feeds the lines to
+ * parsing workers, and a writer thread prints them in their original order.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "LogPipeline.hpp"
+
+
+namespace log_viewer {
+
+
+int LogPipeline::Start(size_t _nWorkers, Stage _parse, Stage _write)
+{
+	Stop();
+
+	if(_nWorkers == 0)
+		return -1;
+
+	parse = _parse;
+	write = _write;
+	stop = false;
+	stopWriter = false;
+	nPushed = 0;
+	nWritten = 0;
+
+	// Lines pushed and not yet written: in the worker rings and hands, and up to
+	// a ring of them on each side of the oldest one in the writer ring
+	reorder.assign((2 * _nWorkers + 1) * (ringSize + 1), Item());
+	ready.assign(reorder.size(), false);
+
+	toWriter.reset(new MpscRing<Item>(ringSize));
+
+	for(size_t w = 0; w < _nWorkers; ++w)
+		toWorkers.emplace_back(new SpscRing<Item>(ringSize));
+
+	for(size_t w = 0; w < _nWorkers; ++w)
+		workers.emplace_back(&LogPipeline::WorkerLoop, this, w);
+
+	writer = std::thread(&LogPipeline::WriterLoop, this);
+
+	return int(_nWorkers);
+}
+
+
+void LogPipeline::Stop()
+{
+	if(workers.empty())
+		return;
+
+	// The workers may still push what is left in their rings: the writer ends after them
+	stop = true;
+
+	for(auto &ring : toWorkers)
+		ring->Wake();
+
+	for(std::thread &t : workers)
+		t.join();
+
+	stopWriter = true;
+	toWriter->Wake();
+	writer.join();
+
+	workers.clear();
+	toWorkers.clear();
+	toWriter.reset();
+}
+
+
+void LogPipeline::Push(std::string_view _line, size_t _source, int _level, std::string_view _file)
+{
+	Item item;
+	item.seq = nPushed;
+	item.line.assign(_line.data(), _line.size());
+	item.source = _source;
+	item.level = _level;
+	item.file.assign(_file.data(), _file.size());
+
+	toWorkers[nPushed % toWorkers.size()]->Push(std::move(item));
+
+	++nPushed;
+}
+
+
+void LogPipeline::Drain()
+{
+	drained.Wait([this] { return nWritten.load() == nPushed; });
+}
+
+
+void LogPipeline::WorkerLoop(size_t _w)
+{
+	SpscRing<Item> &in = *toWorkers[_w];
+	Item item;
+
+	while(in.Pop(item, stop))
+	{
+		parse(item);
+		toWriter->Push(std::move(item));
+	}
+}
+
+
+void LogPipeline::WriterLoop()
+{
+	Item item;
+	uint64_t next = 0;		// next line to be written
+
+	while(toWriter->Pop(item, stopWriter))
+	{
+		const size_t slot = size_t(item.seq % reorder.size());
+		reorder[slot] = std::move(item);
+		ready[slot] = true;
+
+		// Write all the lines now in sequence
+		for(size_t s = size_t(next % reorder.size()); ready[s]; s = size_t(next % reorder.size()))
+		{
+			write(reorder[s]);
+
+			ready[s] = false;
+			reorder[s].logs.clear();
+			++next;
+
+			nWritten.store(next);
+			drained.Ring();
+		}
+	}
+}
+
+
+} // log_viewer
@@ -0,0 +1,108 @@
+/******************************************************************************
+ * LogPipeline.hpp
+ *
+ * Staged processing of the logs: the reading thread feeds the lines to
+ * parsing workers, and a writer thread prints them in their original order.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef LOG_PIPELINE_HPP
+#define LOG_PIPELINE_HPP
+
+#include "RingBuffer.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class LogPipeline
+{
+	/**	reader --SPSC--> worker 1 --\
+	 *	       --SPSC--> worker 2 ---MPSC--> writer
+	 *	       --SPSC--> worker n --/
+	 *
+	 *	The lines are numbered and dealt to the workers in turn; the writer
+	 *	puts them back in order before writing them. Full rings block the
+	 *	previous stage, so a slow output slows down the reading, within bounds.
+	 *	Stop() lets the workers empty their rings, then the writer write all
+	 *	they passed on: no line pushed is lost.
+	 */
+
+public:
+	struct Log
+	{
+		size_t  begin, size;		// position in the line
+		int     level;				// as found by the parser, before the context of the previous logs
+	};
+
+	struct Item
+	{
+		uint64_t          seq = 0;
+		std::string       line;
+		size_t            source = 0;	// input file
+		int               level = -1;	// of the whole line, if already known (e.g. given by the producer)
+		std::string       file;			// name of the input file, if printed (the producer's sources may change meanwhile)
+		std::vector<Log>  logs;			// logs in the line
+	};
+
+	typedef std::function<void(Item&)>  Stage;
+
+	static const size_t ringSize = 1024;	// items per ring
+
+	~LogPipeline() { Stop(); }
+
+	// _parse runs on the workers, concurrently; _write on the writer thread, in order
+	int  Start(size_t _nWorkers, Stage _parse, Stage _write);
+	void Stop();
+	bool Running() const { return !workers.empty(); }
+
+	// Send a line to the workers; it may block if the pipeline is full
+	void Push(std::string_view _line, size_t _source = 0, int _level = -1, std::string_view _file = std::string_view());
+
+	// Wait until all the lines pushed so far have been written
+	void Drain();
+
+	// All the lines pushed so far have been written: the writer does not touch the output
+	bool Idle() const { return nWritten.load() == nPushed; }
+
+private:
+	void WorkerLoop(size_t _w);
+	void WriterLoop();
+
+	Stage  parse, write;
+
+	std::vector<std::unique_ptr<SpscRing<Item>>>  toWorkers;
+	std::unique_ptr<MpscRing<Item>>               toWriter;
+
+	std::vector<std::thread>  workers;
+	std::thread               writer;
+
+	std::vector<Item>  reorder;			// items waiting for the previous ones, by seq
+	std::vector<bool>  ready;
+
+	uint64_t               nPushed = 0;
+	std::atomic<uint64_t>  nWritten{0};
+	std::atomic<bool>      stop{false};			// for the workers
+	std::atomic<bool>      stopWriter{false};	// once the workers have ended
+	Doorbell               drained;
+};
+
+
+} // log_viewer
+
+
+#endif // LOG_PIPELINE_HPP
@@ -0,0 +1,137 @@
+/// LogPipeline_test.cpp
+
+/**
+	Test of the lock-free rings (log_viewer::SpscRing, MpscRing) and of the
+	log_viewer::LogPipeline stages: order and completeness of the items,
+	with small rings which are often full, and Stop() with items in flight.
+ */
+
+#ifdef LOGPIPELINE_TEST
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LogPipeline.hpp"
+#include "RingBuffer.hpp"
+
+
+int LogPipeline_test()
+{
+	using namespace std;
+	using namespace log_viewer;
+
+	const size_t nItems = 200000;
+	int nErrors = 0;
+
+	const auto check = [&](bool _ok, const char *_what) {
+		if(_ok == false) {
+			cout << "LogPipeline test: " << _what << " - FAILED" << endl;
+			++nErrors;
+		}
+	};
+
+	// Single producer, single consumer: every item, in order
+	{
+		SpscRing<size_t> ring(8);
+		atomic<bool> stop{false};
+		size_t nPopped = 0;
+		bool ordered = true;
+
+		thread consumer([&] {
+			size_t item;
+			while(ring.Pop(item, stop)) {
+				ordered = ordered && item == nPopped;
+				++nPopped;
+			}
+		});
+
+		for(size_t i = 0; i < nItems; ++i)
+			ring.Push(size_t(i));
+
+		// Items still in the ring are popped before the consumer stops
+		stop = true;
+		ring.Wake();
+		consumer.join();
+
+		check(nPopped == nItems, "SpscRing: all the items popped");
+		check(ordered, "SpscRing: items in order");
+	}
+
+	// Multiple producers, single consumer: every item, in the order of each producer
+	{
+		const size_t nProducers = 4;
+
+		MpscRing<size_t> ring(8);
+		atomic<bool> stop{false};
+		vector<thread> producers;
+
+		for(size_t p = 0; p < nProducers; ++p)
+			producers.emplace_back([&ring, p, nItems] {
+				for(size_t i = 0; i < nItems / nProducers; ++i)
+					ring.Push(size_t(i * nProducers + p));
+			});
+
+		vector<size_t> next(nProducers, 0);
+		size_t nPopped = 0;
+		bool ordered = true;
+
+		thread consumer([&] {
+			size_t item;
+			while(ring.Pop(item, stop)) {
+				ordered = ordered && item / nProducers == next[item % nProducers]++;
+				++nPopped;
+			}
+		});
+
+		for(thread &t : producers)
+			t.join();
+
+		stop = true;
+		ring.Wake();
+		consumer.join();
+
+		check(nPopped == nItems, "MpscRing: all the items popped");
+		check(ordered, "MpscRing: items in the order of each producer");
+	}
+
+	// Pipeline: each line parsed once, written once and in order, also when stopped with lines in flight
+	for(size_t nWorkers : { 1, 3, 8 })
+	{
+		LogPipeline pipeline;
+		size_t nWritten = 0;
+		bool ordered = true, parsed = true;
+
+		pipeline.Start(nWorkers,
+			[](LogPipeline::Item &_item) {
+				_item.logs.push_back(LogPipeline::Log{ 0, _item.line.size(), int(_item.line.size() % 7) });
+			},
+			[&](LogPipeline::Item &_item) {
+				ordered = ordered && _item.line == to_string(nWritten);
+				parsed = parsed && _item.logs.size() == 1 && _item.logs[0].level == int(_item.line.size() % 7);
+				++nWritten;
+			});
+
+		for(size_t i = 0; i < nItems / 2; ++i)
+			pipeline.Push(to_string(i));
+
+		pipeline.Drain();
+		check(pipeline.Idle() && nWritten == nItems / 2, "LogPipeline: all the lines written after Drain()");
+
+		for(size_t i = nItems / 2; i < nItems; ++i)
+			pipeline.Push(to_string(i));
+
+		pipeline.Stop();
+
+		check(nWritten == nItems, "LogPipeline: all the lines written after Stop()");
+		check(ordered, "LogPipeline: lines in order");
+		check(parsed, "LogPipeline: lines parsed");
+	}
+
+	cout << "LogPipeline test: " << nErrors << " errors" << endl;
+
+	return nErrors;
+}
+
+#endif // LOGPIPELINE_TEST
@@ -0,0 +1,874 @@
+/******************************************************************************
+ * LogReader.cpp
+ *
+ * Input layer: read the log file line by line.
+ * Different implementations can be selected at runtime (--reader).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "LogReader.hpp"
+#include "ColdLogReader.hpp"
+#include "CompressedLogReader.hpp"
+#include "ShmLogReader.hpp"
+#include "SyslogLogReader.hpp"
+#include "UringLogReader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <fcntl.h>
+#include <poll.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <sys/stat.h>
+
+
+namespace log_viewer {
+
+
+LogReader* LogReader::Create(const std::string &_type)
+{
+	if(_type.empty() || _type == "stream")
+		return new StreamLogReader;
+
+	if(_type == "mmap") {
+#ifdef POSIX
+		return new MmapLogReader;
+#else
+		std::cerr << "logviewer: warning: memory mapped reader not available on this platform; using the stream reader." << std::endl;
+		return new StreamLogReader;
+#endif
+	}
+
+	if(_type == "uring") {
+#ifdef HAVE_IO_URING
+		if(UringReadBatch::Available())
+			return new UringLogReader;
+		std::cerr << "logviewer: warning: io_uring not allowed by the system; using the stream reader." << std::endl;
+#else
+		std::cerr << "logviewer: warning: io_uring reader not available in this build; using the stream reader." << std::endl;
+#endif
+		return new StreamLogReader;
+	}
+
+	if(_type == "cold" || _type == "direct") {
+#ifdef POSIX
+		return new ColdLogReader(_type == "direct");
+#else
+		std::cerr << "logviewer: warning: cold scan reader not available on this platform; using the stream reader." << std::endl;
+		return new StreamLogReader;
+#endif
+	}
+
+	if(_type == "shm")
+		return new ShmLogReader;
+
+	if(_type == "syslog")
+		return new SyslogLogReader;
+
+	return nullptr;
+}
+
+
+LogReader* LogReader::Create(const std::string &_type, const std::string &_fileName)
+{
+	// The name of a shared memory ring, or the address of a socket, is not a file
+	if(_type == "shm" || _type == "syslog")
+		return Create(_type);
+
+	if(_fileName == stdinName) {
+#ifdef POSIX
+		return new PipeLogReader;
+#else
+		std::cerr << "logviewer: warning: reading the standard input is not available on this platform." << std::endl;
+#endif
+	}
+
+	const int codec = CompressedLogReader::Detect(_fileName);
+
+	if(codec != CompressedLogReader::codec_none)
+	{
+		if(CompressedLogReader::Available(codec))
+			return new CompressedLogReader;
+
+		std::cerr << "logviewer: warning: " << CompressedLogReader::CodecName(codec)
+		          << " decompression not available in this build; " << _fileName << " will be read as it is." << std::endl;
+	}
+
+	return Create(_type);
+}
+
+
+/// Files next to _fileName named after it, with a rotation index or date and an optional compression suffix;
+/// ordered by index if all of them have one, by modification time otherwise
+
+std::vector<std::string> LogReader::RotatedFiles(const std::string &_fileName)
+{
+	namespace fs = std::filesystem;
+
+	struct Rotated
+	{
+		std::string         name;
+		long                index;		// -1 if the suffix is not a plain number
+		fs::file_time_type  time;
+	};
+
+	const fs::path     path(_fileName);
+	const std::string  base = path.filename().string();
+	const fs::path     dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+
+	std::vector<Rotated> files;
+	bool allIndexed = true;
+	std::error_code ec;
+
+	for(fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		const std::string name = it->path().filename().string();
+
+		if(name.size() < base.size() + 2 || name.compare(0, base.size(), base) != 0)
+			continue;
+
+		const char sep = name[base.size()];
+
+		if(sep != '.' && sep != '-' && sep != '_')
+			continue;
+
+		std::string suffix = name.substr(base.size() + 1);
+
+		if(IsRotationSuffix(suffix) == false)
+			continue;
+
+		for(const char *ext : { ".gz", ".zst" })
+			if(suffix.size() > strlen(ext) && suffix.compare(suffix.size() - strlen(ext), std::string::npos, ext) == 0)
+				suffix.erase(suffix.size() - strlen(ext));
+
+		if(it->is_regular_file(ec) == false)
+			continue;
+
+		Rotated r;
+		r.name = path.has_parent_path() ? it->path().string() : name;
+		r.index = (sep == '.' && suffix.find_first_not_of("0123456789") == std::string::npos && suffix.size() < 10)
+		          ? std::stol(suffix) : -1;
+		r.time = it->last_write_time(ec);
+
+		allIndexed = allIndexed && r.index >= 0;
+		files.push_back(r);
+	}
+
+	std::sort(files.begin(), files.end(), [allIndexed](const Rotated &a, const Rotated &b) {
+		if(allIndexed)
+			return a.index > b.index;			// app.log.1 is the latest
+		return a.time != b.time ? a.time < b.time : a.name < b.name;
+	});
+
+	std::vector<std::string> names;
+
+	for(const Rotated &r : files)
+		names.push_back(r.name);
+
+	return names;
+}
+
+
+/// Rotation suffix: digits and separators only, e.g. "3", "20190105", "2019-01-05_1",
+/// with an optional compression extension
+
+bool LogReader::IsRotationSuffix(std::string _suffix)
+{
+	for(const char *ext : { ".gz", ".zst" })
+		if(_suffix.size() > strlen(ext) && _suffix.compare(_suffix.size() - strlen(ext), std::string::npos, ext) == 0)
+			_suffix.erase(_suffix.size() - strlen(ext));
+
+	return _suffix.find_first_not_of("0123456789-_.") == std::string::npos &&
+	       _suffix.find_first_of("0123456789") != std::string::npos;
+}
+
+
+/// Lines longer than maxLineSize
+
+std::string LogReader::CutMarker(size_t _truncated)
+{
+	return " [... " + std::to_string(_truncated) + " bytes truncated]";
+}
+
+
+std::string_view LogReader::Cut(std::string_view _line)
+{
+	if(maxLineSize > 0 && _line.size() > maxLineSize)
+	{
+		if(cutting == false)
+			StartCut(_line.substr(0, maxLineSize));
+
+		Skip(_line.data() + maxLineSize, _line.size() - maxLineSize);
+		_line = _line.substr(0, maxLineSize);
+	}
+
+	EndLine();
+	return _line;
+}
+
+
+void LogReader::StartCut(std::string_view _head)
+{
+	cutting = true;
+	skipped = 0;
+	scanning = cutScan && cutScan(_head, 0);
+}
+
+
+void LogReader::Collect(std::string &_head, const char *_data, size_t _size)
+{
+	if(maxLineSize > 0 && _head.size() + _size > maxLineSize)
+	{
+		const size_t keep = maxLineSize - std::min(_head.size(), maxLineSize);
+		_head.append(_data, keep);
+
+		if(cutting == false)
+			StartCut(_head);
+
+		Skip(_data + keep, _size - keep);
+	}
+	else {
+		_head.append(_data, _size);
+	}
+}
+
+
+void LogReader::Skip(const char *_data, size_t _size)
+{
+	// The scan gets parts of a bounded size, even from a line all in memory
+	static const size_t maxPart = 1 << 20;
+
+	for(size_t i = 0; scanning && i < _size; i += maxPart)
+		scanning = cutScan(std::string_view(_data + i, std::min(maxPart, _size - i)), maxLineSize + skipped + i);
+
+	skipped += _size;
+}
+
+
+/// Search the latest logs backwards, one large aligned block at a time
+
+std::streamoff LogReader::FindLatestLogs(int _nLogs, const ByteSet &_delimiters)
+{
+	const std::streamoff blockSize = 1 << 20;
+
+	std::streamoff end = Size();
+	int  nLogs = 0;
+	char nextChar = '\0';		// first character of the block after the current one
+
+	while(end > 0)
+	{
+		const std::streamoff begin = ((end - 1) / blockSize) * blockSize;
+
+		const char *block = nullptr;
+		const size_t size = ReadBlock(begin, size_t(end - begin), block);
+
+		if(size == 0)
+			break;
+
+		const char *p = block + size;
+
+		while((p = _delimiters.FindLast(block, p)) != nullptr)
+		{
+			// A dot followed by a digit is a decimal point, not a delimiter
+			const char next = (p + 1 < block + size) ? p[1] : nextChar;
+			if(*p == '.' && next >= '0' && next <= '9')
+				continue;
+
+			if(++nLogs > _nLogs)
+				return begin + (p - block) + 1;
+		}
+
+		nextChar = block[0];
+		end = begin;
+	}
+
+	return 0;
+}
+
+
+int LogReader::CheckFile(const std::string &_fileName)
+{
+	struct stat st;
+
+	if(stat(_fileName.c_str(), &st) != 0)
+		return file_missing;
+
+	if(!IsOpen() || uint64_t(st.st_ino) != inode) {
+		checkPos = -1;
+		return file_rotated;
+	}
+
+	const std::streamoff pos = Tell();
+
+	if(std::streamoff(st.st_size) < pos)
+		return file_truncated;
+
+	// A truncated file can grow again beyond the current position before it is checked:
+	// the byte before the position must be the same seen by the previous check
+	const char *block = nullptr;
+
+	if(pos > 0 && ReadBlock(pos - 1, 1, block) == 1)
+	{
+		if(pos == checkPos && *block != checkByte)
+			return file_truncated;
+
+		checkPos = pos;
+		checkByte = *block;
+	}
+
+	return file_unchanged;
+}
+
+
+/// StreamLogReader
+
+int StreamLogReader::Open(const std::string &_fileName)
+{
+	ifs.open(_fileName);
+	pos = 0;
+	taken = 0;
+	ResetCut();
+
+	if(ifs.is_open() == false)
+		return err_openFailed;
+
+	struct stat st;
+	inode = (stat(_fileName.c_str(), &st) == 0) ? uint64_t(st.st_ino) : 0;
+
+	return 0;
+}
+
+
+bool StreamLogReader::GetLine(std::string_view &_line)
+{
+	// A partial line held by the previous call goes on where the stream stopped
+	if(taken == 0)
+		line.clear();
+
+	chunk.resize(64 << 10);
+
+	while(true)
+	{
+		ifs.getline(chunk.data(), std::streamsize(chunk.size()));
+
+		// The new line is extracted, not stored; a full chunk without it means a longer line
+		const size_t n = size_t(ifs.gcount());
+		const bool   full = ifs.fail() && ifs.eof() == false;
+		const bool   newLine = ifs.fail() == false && ifs.eof() == false;
+
+		Collect(line, chunk.data(), n - (newLine ? 1 : 0));
+		taken += n;
+
+		if(full) {
+			ifs.clear();
+			continue;
+		}
+
+		if(newLine)
+			break;
+
+		// End of the data: without a new line, return the rest, as getline() would do, or hold it
+		if(taken == 0 || holdPartial)
+			return false;
+
+		break;
+	}
+
+	pos += taken;
+	taken = 0;
+
+	EndLine();
+	_line = line;
+	return true;
+}
+
+
+int StreamLogReader::Seek(std::streamoff _pos)
+{
+	if(_pos < 0)
+		_pos = 0;
+
+	ifs.clear();
+	ifs.seekg(_pos);
+
+	if(ifs.fail())
+		return err_seekFailed;
+
+	pos = _pos;
+	taken = 0;
+	ResetCut();
+	return 0;
+}
+
+
+std::streamoff StreamLogReader::Size()
+{
+	ifs.clear();
+	ifs.seekg(0, std::ios::end);
+	const std::streamoff size = ifs.tellg();
+	ifs.seekg(pos + taken);
+
+	return size;
+}
+
+
+size_t StreamLogReader::ReadBlock(std::streamoff _pos, size_t _size, const char *&_block)
+{
+	block.resize(_size);
+
+	ifs.clear();
+	ifs.seekg(_pos);
+	ifs.read(block.data(), std::streamsize(_size));
+	const size_t n = size_t(ifs.gcount());
+
+	ifs.clear();
+	ifs.seekg(pos + taken);
+
+	_block = block.data();
+	return n;
+}
+
+
+/// MmapLogReader
+
+#ifdef POSIX
+
+namespace {
+
+// The mapping being read by this thread, and where a SIGBUS in it jumps back to
+thread_local sigjmp_buf  *sigbusJump = nullptr;
+thread_local uintptr_t    sigbusBegin = 0, sigbusEnd = 0;
+struct sigaction          previousSigbus;
+
+
+void OnSigbus(int _signal, siginfo_t *_info, void *_context)
+{
+	const uintptr_t addr = uintptr_t(_info->si_addr);
+
+	// Beyond the end of a file truncated while it is read: back to the reader
+	if(sigbusJump != nullptr && addr >= sigbusBegin && addr < sigbusEnd)
+		siglongjmp(*sigbusJump, 1);
+
+	// Not a mapped log: as it would have been without this handler
+	if(previousSigbus.sa_flags & SA_SIGINFO)
+		return previousSigbus.sa_sigaction(_signal, _info, _context);
+
+	if(previousSigbus.sa_handler != SIG_IGN && previousSigbus.sa_handler != SIG_DFL)
+		return previousSigbus.sa_handler(_signal);
+
+	sigaction(SIGBUS, &previousSigbus, nullptr);		// the fault happens again, with the default action
+}
+
+
+void InstallSigbus()
+{
+	// SA_NODEFER: SIGBUS is not left blocked after jumping out of the handler
+	static const bool installed = [] {
+		struct sigaction sa;
+		std::memset(&sa, 0, sizeof(sa));
+		sa.sa_sigaction = OnSigbus;
+		sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+		sigemptyset(&sa.sa_mask);
+		return sigaction(SIGBUS, &sa, &previousSigbus) == 0;
+	}();
+
+	(void)installed;
+}
+
+
+// Only memchr() and memcpy() run between Arm() and Disarm(): nothing to unwind after the jump
+void Arm(sigjmp_buf *_jump, const char *_data, size_t _size)
+{
+	sigbusBegin = uintptr_t(_data);
+	sigbusEnd = uintptr_t(_data) + _size;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	sigbusJump = _jump;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+
+void Disarm()
+{
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+	sigbusJump = nullptr;
+}
+
+} // anonymous
+
+
+int MmapLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	fd = open(_fileName.c_str(), O_RDONLY);
+
+	if(fd < 0)
+		return err_openFailed;
+
+	InstallSigbus();
+
+	struct stat st;
+	inode = (fstat(fd, &st) == 0) ? uint64_t(st.st_ino) : 0;
+
+	cursor = 0;
+
+	return Remap();
+}
+
+
+void MmapLogReader::Close()
+{
+	Unmap();
+
+	if(fd >= 0)
+		close(fd);
+
+	cursor = 0;
+	scanned = 0;
+	fd = -1;
+}
+
+
+bool MmapLogReader::GetLine(std::string_view &_line)
+{
+	if(cursor >= mappedSize)
+		return false;
+
+	const char  *begin = data + cursor;
+	const size_t avail = mappedSize - cursor;
+
+	if(scanned > avail)
+		scanned = 0;		// the file has shrunk
+
+	// The file shrunk while it was read: its new end is mapped, and CheckFile() detects the truncation
+	sigjmp_buf jump;
+
+	if(sigsetjmp(jump, 0) != 0) {
+		Disarm();
+		Remap();
+		scanned = 0;
+		return false;
+	}
+
+	Arm(&jump, data, mappedSize);
+	const char  *nl = static_cast<const char*>(std::memchr(begin + scanned, '\n', avail - scanned));
+	Disarm();
+
+	// Without a new line, the end of the mapping may be beyond the end of a truncated file: remap
+	const std::streamoff size = (nl == nullptr) ? Size() : -1;
+
+	if(size >= 0 && size_t(size) < mappedSize) {
+		Remap();
+		scanned = 0;
+		return cursor < mappedSize && GetLine(_line);
+	}
+
+	// A partial line is searched no more, when the file grows
+	if(nl == nullptr && holdPartial) {
+		scanned = avail;
+		return false;
+	}
+
+	scanned = 0;
+
+	// Without a new line, return the rest of the mapping, as getline() would do
+	const size_t len = (nl != nullptr) ? size_t(nl - begin) : avail;
+
+	// A copy: the mapped bytes may vanish with a truncation before the caller reads them
+	line.resize(len);
+
+	Arm(&jump, data, mappedSize);
+	std::memcpy(&line[0], begin, len);
+	Disarm();
+
+	_line = Cut(line);
+	cursor += len + (nl != nullptr ? 1 : 0);
+
+	return true;
+}
+
+
+int MmapLogReader::Seek(std::streamoff _pos)
+{
+	if(_pos < 0)
+		_pos = 0;
+
+	Remap();
+
+	if(size_t(_pos) > mappedSize)
+		_pos = std::streamoff(mappedSize);
+
+	cursor = size_t(_pos);
+	scanned = 0;
+	return 0;
+}
+
+
+std::streamoff MmapLogReader::Size()
+{
+	struct stat st;
+
+	if(fd < 0 || fstat(fd, &st) != 0)
+		return -1;
+
+	return std::streamoff(st.st_size);
+}
+
+
+size_t MmapLogReader::ReadBlock(std::streamoff _pos, size_t _size, const char *&_block)
+{
+	Remap();
+
+	if(_pos < 0 || size_t(_pos) >= mappedSize)
+		return 0;
+
+	// A copy, as for the lines
+	const size_t n = std::min(_size, mappedSize - size_t(_pos));
+	block.resize(n);
+
+	sigjmp_buf jump;
+
+	if(sigsetjmp(jump, 0) != 0) {
+		Disarm();
+		Remap();
+		return 0;
+	}
+
+	Arm(&jump, data, mappedSize);
+	std::memcpy(block.data(), data + _pos, n);
+	Disarm();
+
+	_block = block.data();
+	return n;
+}
+
+
+int MmapLogReader::CheckFile(const std::string &_fileName)
+{
+	Remap();
+	return LogReader::CheckFile(_fileName);
+}
+
+
+int MmapLogReader::Remap()
+{
+	const std::streamoff size = Size();
+
+	if(size < 0)
+		return err_openFailed;
+
+	if(size_t(size) == mappedSize)
+		return 0;
+
+	// The file has been truncated or has grown: map it again
+	Unmap();
+
+	if(size > 0)
+	{
+		void *p = mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+
+		if(p == MAP_FAILED)
+			return err_openFailed;
+
+		madvise(p, size_t(size), MADV_SEQUENTIAL);
+
+		data = static_cast<const char*>(p);
+		mappedSize = size_t(size);
+	}
+
+	// The cursor is left beyond a truncated end, so that CheckFile() can detect it
+	return 0;
+}
+
+
+void MmapLogReader::Unmap()
+{
+	if(data != nullptr)
+		munmap(const_cast<char*>(data), mappedSize);
+
+	data = nullptr;
+	mappedSize = 0;
+}
+
+
+/// PipeLogReader
+
+int PipeLogReader::Open(const std::string &)
+{
+	const int r = Attach(STDIN_FILENO);
+	owned = false;
+
+	return r;
+}
+
+
+int PipeLogReader::Attach(int _fd)
+{
+	Close();
+
+	if(_fd < 0)
+		return err_openFailed;
+
+	fd = _fd;
+	owned = true;
+	eof = false;
+
+	buffer.resize(256 << 10);
+	begin = end = scanned = 0;
+	pos = 0;
+
+	return 0;
+}
+
+
+void PipeLogReader::Close()
+{
+	if(owned && fd >= 0)
+		close(fd);
+
+	fd = -1;
+	owned = false;
+}
+
+
+std::vector<int> PipeLogReader::PollFds() const
+{
+	// A closed pipe is always readable
+	if(fd < 0 || eof)
+		return std::vector<int>();
+
+	return std::vector<int>(1, fd);
+}
+
+
+bool PipeLogReader::GetLine(std::string_view &_line, bool _read)
+{
+	while(true)
+	{
+		const char *first = buffer.data() + begin;
+		const char *nl = static_cast<const char*>(std::memchr(first + scanned, '\n', end - begin - scanned));
+
+		if(nl != nullptr) {
+			const size_t len = size_t(nl - first);
+			_line = Cut(std::string_view(first, len));
+			begin += len + 1;
+			pos += std::streamoff(_line.size() + truncated + 1);
+			scanned = 0;
+			return true;
+		}
+
+		scanned = end - begin;
+
+		// Keep the beginning of a long line; the rest is dropped as it arrives
+		if(maxLineSize > 0 && scanned > maxLineSize)
+		{
+			if(cutting == false)
+				StartCut(std::string_view(first, maxLineSize));
+
+			Skip(first + maxLineSize, scanned - maxLineSize);
+			end = begin + maxLineSize;
+			scanned = maxLineSize;
+		}
+
+		if(eof)
+		{
+			if(begin == end)
+				return false;
+
+			// Without a new line at the end of the input, return the rest, as getline() would do
+			_line = Cut(std::string_view(first, end - begin));
+			pos += std::streamoff(_line.size() + truncated);
+			begin = end;
+			scanned = 0;
+			return true;
+		}
+
+		if(_read == false || Fill() <= 0)
+			return false;
+	}
+}
+
+
+int PipeLogReader::Seek(std::streamoff _pos)
+{
+	// The data already read is gone
+	if(_pos < pos)
+		return err_seekFailed;
+
+	// A long line being skipped is done with
+	if(cutting) {
+		pos += std::streamoff(end - begin + skipped);
+		begin = end;
+		scanned = 0;
+		ResetCut();
+	}
+
+	while(pos < _pos)
+	{
+		if(begin == end) {
+			if(eof || Fill() <= 0)
+				break;
+			continue;
+		}
+
+		const size_t n = std::min(end - begin, size_t(_pos - pos));
+		begin += n;
+		pos += std::streamoff(n);
+		scanned = 0;
+	}
+
+	return 0;
+}
+
+
+int PipeLogReader::Fill()
+{
+	// Make room: move a partial line to the front, or grow the buffer for a long one
+	if(begin > 0) {
+		std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+		end -= begin;
+		begin = 0;
+	}
+
+	if(end == buffer.size())
+		buffer.resize(2 * buffer.size());
+
+	struct pollfd pfd = { fd, POLLIN, 0 };
+
+	if(poll(&pfd, 1, 0) <= 0)
+		return 0;
+
+	const ssize_t n = read(fd, buffer.data() + end, buffer.size() - end);
+
+	if(n == 0 || (n < 0 && errno != EINTR && errno != EAGAIN))
+		eof = true;
+
+	if(n <= 0)
+		return 0;
+
+	end += size_t(n);
+	return int(n);
+}
+
+#endif // POSIX
+
+
+} // log_viewer
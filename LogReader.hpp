@@ -0,0 +1,279 @@
+/******************************************************************************
+ * LogReader.hpp
+ *
+ * Input layer: read the log file line by line.
+ * Different implementations can be selected at runtime (--reader).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef LOG_READER_HPP
+#define LOG_READER_HPP
+
+#include "ByteScan.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class LogReader
+{
+	/** The lines returned by GetLine() are views on the reader's internal buffers:
+	 *  they are valid until the next call to GetLine(), Seek() or Clear().
+	 *  With a maximum line size, a longer line is returned truncated: the reader
+	 *  keeps its beginning, and skips the rest as it reads it, without storing it.
+	 *  When following a growing file, a last line still without its new line
+	 *  (flushed in the middle by the writer) is held by the reader, and completed
+	 *  with the data appended later, without reading its beginning again.
+	 */
+
+public:
+	static const int err_openFailed = -1,
+	                 err_seekFailed = -2;
+
+	// File changes detected by CheckFile()
+	static const int file_unchanged = 0,
+	                 file_rotated   = 1,		// the name now refers to another file
+	                 file_truncated = 2,		// shorter than the current position (e.g. copytruncate)
+	                 file_missing   = 3;		// renamed or deleted, not yet recreated
+
+	// Receives the parts of a truncated line, at _offset in the line: first the part kept (_offset 0),
+	// then the ones skipped, as they are read; it returns false when it needs no more of them
+	typedef std::function<bool(std::string_view _part, size_t _offset)>  CutScan;
+
+	virtual ~LogReader() {}
+
+	virtual int  Open(const std::string &_fileName) = 0;
+	virtual void Close() = 0;
+	virtual bool IsOpen() const = 0;
+
+	// Get the next line, without the trailing new line; false if no more data is available
+	virtual bool GetLine(std::string_view &_line) = 0;
+
+	virtual std::streamoff Tell() const = 0;			// offset of the next line to be read
+	virtual int            Seek(std::streamoff _pos) = 0;
+	virtual std::streamoff Size() = 0;					// current size of the file
+
+	// Reset the end of file state, to keep reading a growing file
+	virtual void Clear() = 0;
+
+	// Read a block of the file, without moving the reading position;
+	// _block points to the data, valid until the next call; return the number of bytes available
+	virtual size_t ReadBlock(std::streamoff _pos, size_t _size, const char *&_block) = 0;
+
+	// Lines longer than _size bytes are truncated to _size (0: no limit); _scan, if given, sees the parts skipped
+	virtual void SetMaxLineSize(size_t _size, CutScan _scan = nullptr) { maxLineSize = _size; cutScan = _scan; }
+	size_t       Truncated() const    { return truncated; }		// bytes cut from the last line
+
+	// Shown at the end of a truncated line
+	static std::string CutMarker(size_t _truncated);
+
+	// Hold a last line without new line until the rest of it is appended (e.g. following a file);
+	// otherwise it is returned as it is, as getline() would do. Tell() stays at its beginning
+	void SetHoldPartial(bool _hold)       { holdPartial = _hold; }
+
+	// Random access with ReadBlock() and Seek(); false for sequential inputs (e.g. compressed files)
+	virtual bool Seekable() const { return true; }
+
+	// Level of the last line, if the input gives it (e.g. syslog severity); -1 to find it in the text
+	virtual int Level() const { return -1; }
+
+	// No more data will come (e.g. the writer has closed the pipe)
+	virtual bool Ended() const { return false; }
+
+	// Descriptors which become readable when new data arrives; none for files
+	virtual std::vector<int> PollFds() const { return std::vector<int>(); }
+
+	// Offset of the first of the latest _nLogs logs, each one terminated by any of the _delimiters
+	std::streamoff FindLatestLogs(int _nLogs, const ByteSet &_delimiters);
+
+	virtual const char* Type() const = 0;
+
+	// Compare the open file with the one currently named _fileName
+	virtual int CheckFile(const std::string &_fileName);
+	uint64_t    Inode() const { return inode; }		// of the open file; 0 if unknown
+
+	// Reader factory; _type = stream, mmap, uring, cold, direct, shm, syslog; 0 if the type is unknown
+	static LogReader* Create(const std::string &_type);
+
+	// Reader for _fileName: a decompressing one if the file is compressed, of _type otherwise;
+	// stdinName reads the standard input
+	static LogReader* Create(const std::string &_type, const std::string &_fileName);
+
+	static constexpr const char *stdinName = "-";
+
+	// Rotated files of _fileName (e.g. app.log.2.gz, app.log.1, app.log-20190105), oldest first
+	static std::vector<std::string> RotatedFiles(const std::string &_fileName);
+	static bool IsRotationSuffix(std::string _suffix);		// e.g. "2.gz", after the separator
+	static const char* AvailableTypes() { return "stream mmap uring cold direct"; }
+
+protected:
+	// For the readers, at the end of each line: the part of _line to keep, as many as maxLineSize bytes;
+	// _line is the whole line, or the head of a line already being cut followed by the bytes not yet skipped
+	std::string_view Cut(std::string_view _line);
+
+	// For the readers: a line found longer than maxLineSize, of which _head is kept; the following bytes
+	// go to Skip() as they are read, then the line is returned with EndLine()
+	void StartCut(std::string_view _head);
+	void Skip(const char *_data, size_t _size);
+	void EndLine()                { truncated = skipped; skipped = 0; cutting = false; }
+	void ResetCut()               { skipped = 0; cutting = false; }		// e.g. after a jump
+
+	// For the readers: append the bytes of the line being read to _head, as far as maxLineSize; skip the rest
+	void Collect(std::string &_head, const char *_data, size_t _size);
+
+	size_t   maxLineSize = 0;
+	CutScan  cutScan;
+	size_t   truncated = 0;
+	size_t   skipped = 0;			// of the line being read
+	bool     cutting = false;		// the line being read is too long
+	bool     scanning = false;		// cutScan still wants the skipped parts
+
+	bool     holdPartial = false;
+
+	uint64_t  inode = 0;		// identity of the open file
+
+	std::streamoff  checkPos = -1;		// position at the previous CheckFile()
+	char            checkByte = '\0';	// byte just before checkPos
+};
+
+
+/// Reader based on std::ifstream
+
+class StreamLogReader : public LogReader
+{
+public:
+	int  Open(const std::string &_fileName) override;
+	void Close() override                  { ifs.close(); }
+	bool IsOpen() const override           { return ifs.is_open(); }
+
+	bool GetLine(std::string_view &_line) override;
+
+	std::streamoff Tell() const override   { return pos; }
+	int            Seek(std::streamoff _pos) override;
+	std::streamoff Size() override;
+
+	void Clear() override                  { ifs.clear(); }
+
+	size_t ReadBlock(std::streamoff _pos, size_t _size, const char *&_block) override;
+
+	const char* Type() const override      { return "stream"; }
+
+private:
+	std::ifstream   ifs;
+	std::string     line;
+	std::vector<char>  chunk;			// of the line being read
+	std::vector<char>  block;
+	std::streamoff  pos = 0;
+	std::streamoff  taken = 0;			// bytes of a partial line already taken from the stream
+};
+
+
+/// Reader based on a memory mapped file; the mapping grows with the file
+
+class MmapLogReader : public LogReader
+{
+public:
+	~MmapLogReader() override              { Close(); }
+
+	int  Open(const std::string &_fileName) override;
+	void Close() override;
+	bool IsOpen() const override           { return fd >= 0; }
+
+	bool GetLine(std::string_view &_line) override;
+
+	std::streamoff Tell() const override   { return std::streamoff(cursor); }
+	int            Seek(std::streamoff _pos) override;
+	std::streamoff Size() override;
+
+	void Clear() override                  { Remap(); }
+
+	size_t ReadBlock(std::streamoff _pos, size_t _size, const char *&_block) override;
+
+	// The mapping follows a shrinking file before its bytes are read again
+	int CheckFile(const std::string &_fileName) override;
+
+	const char* Type() const override      { return "mmap"; }
+
+private:
+	/** The mapping follows the size of the file, as fstat() gives it, before
+	 *  the bytes beyond the last known end are read. A file truncated while it
+	 *  is being read makes the pages beyond its new end invalid: the SIGBUS
+	 *  raised by the reader touching them jumps back to it, which maps the file
+	 *  again, and CheckFile() reports the truncation. The lines and the blocks
+	 *  are copied out of the mapping, so that the caller never touches it.
+	 */
+
+	int  Remap();		// follow the file size
+	void Unmap();
+
+	int          fd = -1;
+	const char  *data = nullptr;		// mapped file
+	size_t       mappedSize = 0;
+	size_t       cursor = 0;			// offset of the next line
+	size_t       scanned = 0;			// bytes after cursor already searched for a new line
+	std::string  line;
+	std::vector<char>  block;
+};
+
+
+/// Reader of the standard input or of another pipe: sequential, and never blocking
+
+class PipeLogReader : public LogReader
+{
+public:
+	~PipeLogReader() override              { Close(); }
+
+	int  Open(const std::string &_fileName) override;		// the standard input; _fileName is ignored
+	int  Attach(int _fd);									// a pipe, closed by Close()
+	void Close() override;
+	bool IsOpen() const override           { return fd >= 0; }
+
+	bool GetLine(std::string_view &_line) override { return GetLine(_line, true); }
+	bool GetLine(std::string_view &_line, bool _read);		// without _read, only from the data already received
+	int  Fill();			// read the data available, without waiting; return the bytes read
+
+	std::streamoff Tell() const override   { return pos; }
+	int            Seek(std::streamoff _pos) override;		// forward only
+	std::streamoff Size() override         { return pos + std::streamoff(end - begin + skipped); }	// received so far
+
+	void Clear() override                  {}
+
+	size_t ReadBlock(std::streamoff, size_t, const char*&) override { return 0; }
+	bool   Seekable() const override       { return false; }
+	bool   Ended() const override          { return eof && begin == end; }
+
+	std::vector<int> PollFds() const override;
+
+	int CheckFile(const std::string&) override { return file_unchanged; }
+
+	const char* Type() const override      { return owned ? "pipe" : "stdin"; }
+
+private:
+	int     fd = -1;
+	bool    owned = false;
+	bool    eof = false;
+
+	std::vector<char>  buffer;
+	size_t  begin = 0, end = 0;			// data not yet returned
+	size_t  scanned = 0;				// bytes after begin already searched for a new line
+	std::streamoff  pos = 0;			// offset of the next line
+};
+
+
+} // log_viewer
+
+
+#endif // LOG_READER_HPP
@@ -0,0 +1,116 @@
+/// LogReader_test.cpp
+
+/**
+	Test of the log_viewer::LogReader classes: a followed file truncated
+	between two read passes, and in the middle of one, also to nothing.
+ */
+
+#ifdef LOGREADER_TEST
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include "LogReader.hpp"
+
+
+static int LogReader_test(const std::string &_type)
+{
+	using namespace std;
+	using namespace log_viewer;
+
+	const string fileName = "LogReader_test.log";
+	int nErrors = 0;
+
+	const auto check = [&](bool _ok, const char *_what) {
+		if(_ok == false) {
+			cout << "LogReader test, " << _type << " reader: " << _what << " - FAILED" << endl;
+			++nErrors;
+		}
+	};
+
+	// Lines over many pages, so that the mapped ones outlive the truncation
+	{
+		ofstream ofs(fileName, ios::trunc);
+		for(int i = 0; i < 20000; ++i)
+			ofs << "log " << i << " INFO some text of the log" << endl;
+	}
+
+	unique_ptr<LogReader> reader(LogReader::Create(_type));
+	reader->SetHoldPartial(true);
+	check(reader->Open(fileName) == 0, "open");
+
+	string_view line;
+	check(reader->GetLine(line) && line == "log 0 INFO some text of the log", "first line");
+
+	// Truncated between two passes (copytruncate), then written again
+	while(reader->GetLine(line)) {}
+	reader->Clear();
+
+	check(truncate(fileName.c_str(), 0) == 0, "truncate");
+	check(reader->CheckFile(fileName) == LogReader::file_truncated, "truncation between passes detected");
+
+	{
+		ofstream ofs(fileName, ios::app);
+		for(int i = 0; i < 20000; ++i)
+			ofs << "new log " << i << endl;
+	}
+
+	reader->Seek(0);
+	reader->Clear();
+	check(reader->GetLine(line) && line == "new log 0", "first line after the truncation");
+
+	// Truncated in the middle of a pass: the reader must not crash, nor return bytes beyond
+	// the new end; then either the truncation is detected, or the reader is still in the file
+	check(truncate(fileName.c_str(), 100) == 0, "truncate in the middle");
+
+	while(reader->GetLine(line))
+		check(line.substr(0, 8) == "new log " && line.find('\0') == string_view::npos, "lines of the file only");
+
+	reader->Clear();
+	check(reader->CheckFile(fileName) == LogReader::file_truncated || reader->Tell() <= reader->Size(),
+	      "truncation in the middle detected");
+
+	reader->Seek(0);
+	reader->Clear();
+	check(reader->GetLine(line) && line == "new log 0", "first line after the second truncation");
+
+	// Truncated to nothing in the middle of a pass: the pages being read vanish (SIGBUS with mmap)
+	{
+		ofstream ofs(fileName, ios::app);
+		for(int i = 0; i < 20000; ++i)
+			ofs << "new log " << i << endl;
+	}
+
+	reader->Clear();
+	check(reader->GetLine(line) && line == "new log 1", "second line");
+	check(truncate(fileName.c_str(), 0) == 0, "truncate to nothing");
+
+	while(reader->GetLine(line))
+		check(line.substr(0, 8) == "new log " && line.find('\0') == string_view::npos, "lines of the file only, after the truncation to nothing");
+
+	reader->Clear();
+	check(reader->CheckFile(fileName) == LogReader::file_truncated, "truncation to nothing detected");
+
+	reader.reset();
+	remove(fileName.c_str());
+
+	return nErrors;
+}
+
+
+int LogReader_test()
+{
+	int nErrors = 0;
+
+	for(const char *type : { "stream", "mmap" })
+		nErrors += LogReader_test(type);
+
+	std::cout << "LogReader test: " << nErrors << " errors" << std::endl;
+
+	return nErrors;
+}
+
+#endif // LOGREADER_TEST
@@ -0,0 +1,278 @@
+/******************************************************************************
+ * RingBuffer.hpp
+ *
+ * Bounded lock-free queues to pass work among threads:
+ *	- SpscRing: single producer, single consumer;
+ *	- MpscRing: multiple producers, single consumer.
+ * Blocking Push()/Pop() spin briefly, then sleep on a Doorbell.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+
+namespace log_viewer {
+
+
+static const size_t cacheLineSize = 64;
+
+
+/// Wake up the threads waiting for a condition; the lock is only taken if someone sleeps
+
+class Doorbell
+{
+	/** No wake up is lost: the waiter counts itself among the sleepers before
+	 *  checking the condition, the ringer publishes the condition before
+	 *  looking for sleepers, with a full fence on both sides. So either the
+	 *  waiter sees the condition, or the ringer sees the sleeper; and then it
+	 *  takes the lock, which the waiter only releases inside wait().
+	 */
+
+public:
+	template<typename Ready>
+	void Wait(Ready _ready)
+	{
+		for(int i = 0; i < nSpins; ++i) {
+			if(_ready())
+				return;
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		sleepers.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		while(!_ready())
+			cv.wait(lock);
+
+		sleepers.fetch_sub(1);
+	}
+
+	// After the condition has been published
+	void Ring()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(sleepers.load() > 0) {
+			std::lock_guard<std::mutex> lock(mutex);
+			cv.notify_all();
+		}
+	}
+
+private:
+	static const int nSpins = 64;
+
+	std::mutex               mutex;
+	std::condition_variable  cv;
+	std::atomic<int>         sleepers{0};
+};
+
+
+inline size_t RingCapacity(size_t _capacity)
+{
+	size_t c = 2;
+	while(c < _capacity)
+		c <<= 1;
+	return c;
+}
+
+
+/// Single producer, single consumer
+
+template<typename T>
+class SpscRing
+{
+public:
+	explicit SpscRing(size_t _capacity)
+		: mask(RingCapacity(_capacity) - 1), slots(new T[mask + 1]) {}
+
+	bool TryPush(T &&_item)
+	{
+		const size_t t = tail.load(std::memory_order_relaxed);
+
+		if(t - head.load(std::memory_order_acquire) > mask)
+			return false;
+
+		slots[t & mask] = std::move(_item);
+		tail.store(t + 1, std::memory_order_release);
+		notEmpty.Ring();
+
+		return true;
+	}
+
+	bool TryPop(T &_item)
+	{
+		const size_t h = head.load(std::memory_order_relaxed);
+
+		if(h == tail.load(std::memory_order_acquire))
+			return false;
+
+		_item = std::move(slots[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		notFull.Ring();
+
+		return true;
+	}
+
+	void Push(T &&_item)
+	{
+		while(!TryPush(std::move(_item)))
+			notFull.Wait([this] { return Size() <= mask; });
+	}
+
+	// Wait for a free slot; false if _stop is set first
+	bool Push(T &&_item, const std::atomic<bool> &_stop)
+	{
+		while(!TryPush(std::move(_item))) {
+			if(_stop.load())
+				return false;
+			notFull.Wait([this, &_stop] { return Size() <= mask || _stop.load(); });
+		}
+
+		return true;
+	}
+
+	// Wait for an item; false if _stop is set and the ring is empty
+	bool Pop(T &_item, const std::atomic<bool> &_stop)
+	{
+		while(!TryPop(_item)) {
+			if(_stop.load())
+				return false;
+			notEmpty.Wait([this, &_stop] { return Size() > 0 || _stop.load(); });
+		}
+
+		return true;
+	}
+
+	size_t Size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+
+	void Wake() { notEmpty.Ring(); notFull.Ring(); }
+
+private:
+	const size_t          mask;
+	std::unique_ptr<T[]>  slots;
+
+	alignas(cacheLineSize) std::atomic<size_t>  head{0};	// next item to pop
+	alignas(cacheLineSize) std::atomic<size_t>  tail{0};	// next free slot
+
+	Doorbell  notEmpty, notFull;
+};
+
+
+/// Multiple producers, single consumer: each slot has a sequence number
+/// telling whether it is free for the producers or ready for the consumer
+
+template<typename T>
+class MpscRing
+{
+public:
+	explicit MpscRing(size_t _capacity)
+		: mask(RingCapacity(_capacity) - 1), cells(new Cell[mask + 1])
+	{
+		for(size_t i = 0; i <= mask; ++i)
+			cells[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	bool TryPush(T &&_item)
+	{
+		size_t pos = tail.load(std::memory_order_relaxed);
+		Cell *cell;
+
+		while(true)
+		{
+			cell = &cells[pos & mask];
+			const ptrdiff_t diff = ptrdiff_t(cell->seq.load(std::memory_order_acquire)) - ptrdiff_t(pos);
+
+			if(diff == 0) {
+				if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if(diff < 0)
+				return false;		// full
+			else
+				pos = tail.load(std::memory_order_relaxed);
+		}
+
+		cell->data = std::move(_item);
+		cell->seq.store(pos + 1, std::memory_order_release);
+		notEmpty.Ring();
+
+		return true;
+	}
+
+	bool TryPop(T &_item)
+	{
+		Cell &cell = cells[head & mask];
+
+		if(cell.seq.load(std::memory_order_acquire) != head + 1)
+			return false;
+
+		_item = std::move(cell.data);
+		cell.seq.store(head + mask + 1, std::memory_order_release);
+		++head;
+		notFull.Ring();
+
+		return true;
+	}
+
+	void Push(T &&_item)
+	{
+		while(!TryPush(std::move(_item)))
+			notFull.Wait([this] { return Full() == false; });
+	}
+
+	bool Pop(T &_item, const std::atomic<bool> &_stop)
+	{
+		while(!TryPop(_item)) {
+			if(_stop.load())
+				return false;
+			notEmpty.Wait([this, &_stop] { return Ready() || _stop.load(); });
+		}
+
+		return true;
+	}
+
+	void Wake() { notEmpty.Ring(); notFull.Ring(); }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t>  seq;
+		T                    data;
+	};
+
+	bool Ready() const { return cells[head & mask].seq.load(std::memory_order_acquire) == head + 1; }
+
+	bool Full() const {
+		const size_t pos = tail.load(std::memory_order_relaxed);
+		return ptrdiff_t(cells[pos & mask].seq.load(std::memory_order_acquire)) - ptrdiff_t(pos) < 0;
+	}
+
+	const size_t             mask;
+	std::unique_ptr<Cell[]>  cells;
+
+	alignas(cacheLineSize) std::atomic<size_t>  tail{0};	// next free slot, shared by the producers
+	alignas(cacheLineSize) size_t               head = 0;	// next item, owned by the consumer
+
+	Doorbell  notEmpty, notFull;
+};
+
+
+} // log_viewer
+
+
+#endif // RING_BUFFER_HPP
@@ -6,6 +6,26 @@
 
 #include <iostream>
 
+#ifdef LOGINDEX_TEST
+int LogIndex_test();
+#endif
+
+#ifdef LOGMERGER_TEST
+int LogMerger_test();
+#endif
+
+#ifdef LOGPIPELINE_TEST
+int LogPipeline_test();
+#endif
+
+#ifdef LOGREADER_TEST
+int LogReader_test();
+#endif
+
+#ifdef TAGSCAN_TEST
+int TagScan_test();
+#endif
+
 
 int RunInternalTests()
 {
@@ -19,6 +39,26 @@ int RunInternalTests()
 	status += ReadKeyboard_test();
 #endif
 
+#ifdef LOGINDEX_TEST
+	status += LogIndex_test();
+#endif
+
+#ifdef LOGMERGER_TEST
+	status += LogMerger_test();
+#endif
+
+#ifdef LOGPIPELINE_TEST
+	status += LogPipeline_test();
+#endif
+
+#ifdef LOGREADER_TEST
+	status += LogReader_test();
+#endif
+
+#ifdef TAGSCAN_TEST
+	status += TagScan_test();
+#endif
+
 	std::cout << "Internal tests result: " << status << std::endl;
 
 	return status;
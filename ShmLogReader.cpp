@@ -0,0 +1,261 @@
+/******************************************************************************
+ * ShmLogReader.cpp
+ *
+ * Input layer: read the logs an application writes to a shared memory
+ * ring (ShmLogRing.hpp), without a file in between (--shm).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "ShmLogReader.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+
+namespace log_viewer {
+
+
+#ifdef POSIX
+
+int ShmLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	// Read and write: the consumed records are given back to the producer
+	const int fd = shm_open(ShmObjectName(_fileName).c_str(), O_RDWR, 0);
+
+	if(fd < 0)
+		return err_openFailed;
+
+	struct stat st;
+
+	if(fstat(fd, &st) != 0 || size_t(st.st_size) < shmHeaderSize) {
+		close(fd);
+		return err_openFailed;
+	}
+
+	void *p = mmap(nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(p == MAP_FAILED)
+		return err_openFailed;
+
+	ShmRingHeader *header = static_cast<ShmRingHeader*>(p);
+	const uint64_t cap = header->capacity;
+
+	// A ring still being created, or something else
+	if(std::memcmp(header->magic, shmMagic, sizeof(shmMagic)) != 0 || header->version != shmVersion ||
+	   header->headerSize < shmHeaderSize || cap < shmAlign || (cap & (cap - 1)) != 0 ||
+	   header->headerSize + cap > uint64_t(st.st_size))
+	{
+		munmap(p, size_t(st.st_size));
+		return err_openFailed;
+	}
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	ring = header;
+	data = static_cast<const char*>(p) + header->headerSize;
+	mapSize = size_t(st.st_size);
+	capacity = cap;
+	inode = uint64_t(st.st_ino);
+
+	next = released = ring->readPos.load(std::memory_order_relaxed);
+	level = shmNoLevel;
+	timestamp = shmNoTimestamp;
+
+	return 0;
+}
+
+
+void ShmLogReader::Close()
+{
+	if(ring == nullptr)
+		return;
+
+	Release();
+	munmap(ring, mapSize);
+
+	ring = nullptr;
+	data = nullptr;
+}
+
+
+void ShmLogReader::Release()
+{
+	if(next != released) {
+		ring->readPos.store(next, std::memory_order_release);
+		released = next;
+	}
+}
+
+
+bool ShmLogReader::GetLine(std::string_view &_line)
+{
+	if(ring == nullptr)
+		return false;
+
+	// The previous line is no longer used
+	Release();
+
+	const uint64_t end = ring->writePos.load(std::memory_order_acquire);
+
+	while(next < end)
+	{
+		const size_t offset = size_t(next & (capacity - 1));
+		const size_t tail = size_t(capacity - offset);
+		const ShmRecord *rec = reinterpret_cast<const ShmRecord*>(data + offset);
+
+		if(tail < sizeof(ShmRecord) || (rec->flags & shm_wrap)) {
+			next += tail;
+			continue;
+		}
+
+		const size_t size = ShmRecordSize(rec->size);
+
+		if(size > tail || next + size > end)
+		{
+			// Not written by a ShmLogWriter: skip all that is there
+			std::cerr << "logviewer: warning: corrupted record in the shared memory ring; "
+			          << (end - next) << " bytes skipped." << std::endl;
+			next = end;
+			break;
+		}
+
+		_line = Cut(std::string_view(reinterpret_cast<const char*>(rec + 1), rec->size));
+		level = rec->level;
+		timestamp = rec->timestamp;
+
+		next += size;
+		return true;
+	}
+
+	Release();
+
+	return false;
+}
+
+
+std::streamoff ShmLogReader::Size()
+{
+	return ring ? std::streamoff(ring->writePos.load(std::memory_order_acquire)) : 0;
+}
+
+
+uint64_t ShmLogReader::Dropped() const
+{
+	return ring ? ring->nDropped.load(std::memory_order_relaxed) : 0;
+}
+
+
+int ShmLogReader::CheckFile(const std::string &_fileName)
+{
+	const int fd = shm_open(ShmObjectName(_fileName).c_str(), O_RDONLY, 0);
+
+	if(fd < 0)
+		return file_missing;
+
+	struct stat st;
+	const int r = fstat(fd, &st);
+	close(fd);
+
+	if(r != 0)
+		return file_missing;
+
+	return (ring == nullptr || uint64_t(st.st_ino) != inode) ? file_rotated : file_unchanged;
+}
+
+
+bool ShmLogReader::Wait(std::chrono::milliseconds _timeout)
+{
+	if(ring == nullptr) {
+		std::this_thread::sleep_for(_timeout);
+		return false;
+	}
+
+	if(ring->writePos.load(std::memory_order_acquire) != next)
+		return true;
+
+#ifdef __linux__
+	// The producer rings the doorbell after a record, if it sees `waiting`;
+	// the check of writePos after setting it catches a record written meanwhile
+	ring->waiting.store(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	const uint32_t bell = ring->doorbell.load(std::memory_order_acquire);
+
+	if(ring->writePos.load(std::memory_order_relaxed) == next)
+	{
+		struct timespec ts;
+		ts.tv_sec = time_t(_timeout.count() / 1000);
+		ts.tv_nsec = long(_timeout.count() % 1000) * 1000000;
+
+		// A shared futex: the producer is another process
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&ring->doorbell), FUTEX_WAIT, bell, &ts, nullptr, 0);
+	}
+
+	ring->waiting.store(0, std::memory_order_relaxed);
+#else
+	// No futex: check often
+	const auto until = std::chrono::steady_clock::now() + _timeout;
+
+	while(ring->writePos.load(std::memory_order_relaxed) == next && std::chrono::steady_clock::now() < until)
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+#endif
+
+	return ring->writePos.load(std::memory_order_acquire) != next;
+}
+
+#else // no POSIX shared memory
+
+int ShmLogReader::Open(const std::string &)
+{
+	static bool warned = false;
+
+	if(warned == false)
+		std::cerr << "logviewer: error: shared memory logs are not available on this platform." << std::endl;
+
+	warned = true;
+	return err_openFailed;
+}
+
+void ShmLogReader::Close() {}
+void ShmLogReader::Release() {}
+bool ShmLogReader::GetLine(std::string_view &) { return false; }
+std::streamoff ShmLogReader::Size() { return 0; }
+uint64_t ShmLogReader::Dropped() const { return 0; }
+int  ShmLogReader::CheckFile(const std::string &) { return file_unchanged; }
+
+bool ShmLogReader::Wait(std::chrono::milliseconds _timeout)
+{
+	std::this_thread::sleep_for(_timeout);
+	return false;
+}
+
+#endif // POSIX
+
+
+} // log_viewer
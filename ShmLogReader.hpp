@@ -0,0 +1,90 @@
+/******************************************************************************
+ * ShmLogReader.hpp
+ *
+ * Input layer: read the logs an application writes to a shared memory
+ * ring (ShmLogRing.hpp), without a file in between (--shm).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef SHM_LOG_READER_HPP
+#define SHM_LOG_READER_HPP
+
+#include "LogReader.hpp"
+#include "ShmLogRing.hpp"
+
+#include <chrono>
+#include <string>
+
+
+namespace log_viewer {
+
+
+class ShmLogReader : public LogReader
+{
+	/** The lines are the records of the ring, returned in place: a record is
+	 *  given back to the producer by the next call to GetLine(), or by Close().
+	 *  Offsets are the positions in the ring, counted since it was created; a
+	 *  new reader starts from the first record not consumed yet, so a restart of
+	 *  logviewer loses nothing the ring still holds.
+	 *  A single reader per ring: the free space is given back through readPos.
+	 *  CheckFile() reports a ring created again by the producer as rotated, and
+	 *  a ring unlinked by the producer as missing.
+	 */
+
+public:
+	~ShmLogReader() override               { Close(); }
+
+	int  Open(const std::string &_fileName) override;		// _fileName: name of the ring
+	void Close() override;
+	bool IsOpen() const override           { return ring != nullptr; }
+
+	bool GetLine(std::string_view &_line) override;
+
+	// Of the last line, as written by the producer
+	int     Level() const override         { return level; }		// shmNoLevel if not given
+	int64_t Timestamp() const              { return timestamp; }	// shmNoTimestamp if not given
+
+	std::streamoff Tell() const override   { return std::streamoff(next); }
+	int            Seek(std::streamoff _pos) override { return _pos == Tell() ? 0 : err_seekFailed; }
+	std::streamoff Size() override;		// written so far
+
+	void Clear() override                  {}
+
+	size_t ReadBlock(std::streamoff, size_t, const char*&) override { return 0; }
+	bool   Seekable() const override       { return false; }
+
+	int CheckFile(const std::string &_fileName) override;
+
+	const char* Type() const override      { return "shm"; }
+
+	// Wait until a record is available, up to _timeout; false on timeout
+	bool Wait(std::chrono::milliseconds _timeout);
+
+	// Logs the producer could not write because the ring was full
+	uint64_t Dropped() const;
+
+private:
+	void Release();		// give the records read back to the producer
+
+	ShmRingHeader *ring = nullptr;
+	const char    *data = nullptr;
+	size_t         mapSize = 0;
+	uint64_t       capacity = 0;
+
+	uint64_t  next = 0;			// position of the next record
+	uint64_t  released = 0;		// readPos last stored
+
+	int      level = shmNoLevel;
+	int64_t  timestamp = shmNoTimestamp;
+};
+
+
+} // log_viewer
+
+
+#endif // SHM_LOG_READER_HPP
@@ -0,0 +1,277 @@
+/******************************************************************************
+ * ShmLogRing.hpp
+ *
+ * Shared memory ring of logs, written by an application and read by
+ * logviewer --shm name, without a file in between.
+ * Header only: a producer needs nothing else from logviewer.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef SHM_LOG_RING_HPP
+#define SHM_LOG_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define SHM_LOG_RING_POSIX 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
+namespace log_viewer {
+
+
+/** Layout of the POSIX shared memory object (native byte order):
+ *
+ *		ShmRingHeader, padded to shmHeaderSize bytes
+ *		data area of `capacity` bytes, a power of 2
+ *
+ *	The data area holds records, aligned to shmAlign bytes, which never wrap
+ *	around its end:
+ *		ShmRecord (16 bytes): text size, level, flags, timestamp
+ *		text: one log, without the final new line, padded to shmAlign
+ *	A record with the shm_wrap flag fills the rest of the area: the next
+ *	record is at its beginning.
+ *
+ *	writePos and readPos count the bytes written and consumed since the ring
+ *	was created, without wrapping: the record at position p is at
+ *	p & (capacity - 1) in the data area. One producer and one consumer:
+ *		- the producer writes a record, then publishes it by moving writePos;
+ *		- the consumer reads it in place, then frees it by moving readPos.
+ *	A record not fitting in the free space is dropped, and counted in
+ *	nDropped: the producer never waits for the consumer.
+ *	When the consumer is about to sleep it sets `waiting`; the producer then
+ *	increments `doorbell` and wakes it (a futex on Linux), so the producer
+ *	makes a system call only for the first record after an idle time.
+ *
+ *	Levels are the ones of logviewer (1 verbose ... 7 fatal); shmNoLevel lets
+ *	logviewer find the level in the text. Timestamps are milliseconds since
+ *	1970-01-01 UTC, or shmNoTimestamp.
+ */
+
+static const char      shmMagic[8] = { 'L', 'V', 'S', 'H', 'M', '0', '1', '\0' };
+static const uint32_t  shmVersion = 1;
+static const size_t    shmHeaderSize = 256;
+static const size_t    shmAlign = 16;
+
+static const int       shmNoLevel = -1;
+static const int64_t   shmNoTimestamp = -1;
+
+static const uint16_t  shm_wrap = 1;		// record flag: padding up to the end of the data area
+
+
+struct ShmRingHeader
+{
+	char      magic[8];						// set last, when the ring is ready
+	uint32_t  version;
+	uint32_t  headerSize;					// offset of the data area
+	uint64_t  capacity;
+
+	alignas(64) std::atomic<uint64_t>  writePos;	// producer
+	std::atomic<uint64_t>              nDropped;
+
+	alignas(64) std::atomic<uint64_t>  readPos;		// consumer
+
+	alignas(64) std::atomic<uint32_t>  doorbell;	// futex word
+	std::atomic<uint32_t>              waiting;		// the consumer is sleeping on doorbell
+};
+
+static_assert(sizeof(ShmRingHeader) <= shmHeaderSize, "ShmRingHeader too large");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory atomics must be lock free");
+
+
+struct ShmRecord
+{
+	uint32_t  size;				// of the text
+	int16_t   level;
+	uint16_t  flags;
+	int64_t   timestamp;
+};
+
+static_assert(sizeof(ShmRecord) == shmAlign, "ShmRecord must be 16 bytes");
+
+
+// Bytes taken by a record with _size bytes of text
+inline size_t ShmRecordSize(size_t _size)
+{
+	return sizeof(ShmRecord) + ((_size + shmAlign - 1) & ~(shmAlign - 1));
+}
+
+
+// POSIX name of the shared memory object: "/name"
+inline std::string ShmObjectName(const std::string &_name)
+{
+	return (_name.empty() || _name[0] != '/') ? "/" + _name : _name;
+}
+
+
+#ifdef SHM_LOG_RING_POSIX
+
+class ShmLogWriter
+{
+	/** Reference producer:
+	 *
+	 *		log_viewer::ShmLogWriter shm;
+	 *		shm.Create("myapp");						// logviewer --shm myapp
+	 *		shm.Write("Connection accepted", 3, nowMs);
+	 *
+	 *	Write() takes no lock: one thread writes to a ring (a ring per thread,
+	 *	or a lock around Write(), with more).
+	 */
+
+public:
+	static const size_t defaultCapacity = 4 << 20;
+
+	ShmLogWriter() {}
+	ShmLogWriter(const ShmLogWriter&) = delete;
+	ShmLogWriter& operator=(const ShmLogWriter&) = delete;
+	~ShmLogWriter() { Close(); }
+
+	// Create the ring, replacing an old one with the same name; _capacity is rounded up to a power of 2
+	int Create(const std::string &_name, size_t _capacity = defaultCapacity)
+	{
+		Close();
+
+		size_t capacity = 4096;
+		while(capacity < _capacity)
+			capacity *= 2;
+
+		const std::string name = ShmObjectName(_name);
+
+		// A new object: a reader of the old one sees it has been replaced
+		shm_unlink(name.c_str());
+
+		const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+
+		if(fd < 0)
+			return -1;
+
+		mapSize = shmHeaderSize + capacity;
+
+		if(ftruncate(fd, off_t(mapSize)) != 0) {
+			close(fd);
+			return -1;
+		}
+
+		void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if(p == MAP_FAILED)
+			return -1;
+
+		// The object is zero filled: the atomics start at 0
+		ring = static_cast<ShmRingHeader*>(p);
+		data = static_cast<char*>(p) + shmHeaderSize;
+
+		ring->version = shmVersion;
+		ring->headerSize = uint32_t(shmHeaderSize);
+		ring->capacity = capacity;
+
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(ring->magic, shmMagic, sizeof(shmMagic));
+
+		return 0;
+	}
+
+	// Append a log; false if the ring is full (the log is dropped) or not created
+	bool Write(std::string_view _text, int _level = shmNoLevel, int64_t _timestamp = shmNoTimestamp)
+	{
+		if(ring == nullptr)
+			return false;
+
+		const uint64_t capacity = ring->capacity;
+		const size_t   size = ShmRecordSize(_text.size());
+
+		uint64_t pos = ring->writePos.load(std::memory_order_relaxed);
+		size_t   offset = size_t(pos & (capacity - 1));
+		const size_t tail = size_t(capacity) - offset;
+
+		// A record does not wrap: the rest of the area is skipped
+		const size_t needed = size + (size > tail ? tail : 0);
+
+		if(pos + needed - ring->readPos.load(std::memory_order_acquire) > capacity) {
+			ring->nDropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		if(size > tail)
+		{
+			ShmRecord *pad = reinterpret_cast<ShmRecord*>(data + offset);
+			pad->size = 0;
+			pad->level = int16_t(shmNoLevel);
+			pad->flags = shm_wrap;
+			pad->timestamp = shmNoTimestamp;
+
+			pos += tail;
+			offset = 0;
+		}
+
+		ShmRecord *rec = reinterpret_cast<ShmRecord*>(data + offset);
+		rec->size = uint32_t(_text.size());
+		rec->level = int16_t(_level);
+		rec->flags = 0;
+		rec->timestamp = _timestamp;
+		std::memcpy(rec + 1, _text.data(), _text.size());
+
+		ring->writePos.store(pos + size, std::memory_order_release);
+
+		// Wake the consumer, if it sleeps
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if(ring->waiting.load(std::memory_order_relaxed) != 0)
+		{
+			ring->doorbell.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+			syscall(SYS_futex, reinterpret_cast<uint32_t*>(&ring->doorbell), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+		}
+
+		return true;
+	}
+
+	uint64_t Dropped() const { return ring ? ring->nDropped.load(std::memory_order_relaxed) : 0; }
+
+	// Unmap the ring; it stays available to logviewer until Unlink()
+	void Close()
+	{
+		if(ring != nullptr)
+			munmap(ring, mapSize);
+
+		ring = nullptr;
+		data = nullptr;
+	}
+
+	static int Unlink(const std::string &_name) { return shm_unlink(ShmObjectName(_name).c_str()); }
+
+private:
+	ShmRingHeader *ring = nullptr;
+	char          *data = nullptr;
+	size_t         mapSize = 0;
+};
+
+#endif // SHM_LOG_RING_POSIX
+
+
+} // log_viewer
+
+
+#endif // SHM_LOG_RING_HPP
@@ -0,0 +1,379 @@
+/******************************************************************************
+ * SyslogLogReader.cpp
+ *
+ * Input layer: receive syslog messages (RFC 3164, RFC 5424) directly from
+ * the applications, on a Unix datagram socket or a localhost UDP port
+ * (--syslog).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "SyslogLogReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#if defined(__unix__) || defined(__linux__) || \
+	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
+	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
+#define POSIX 1
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+namespace log_viewer {
+
+
+/// Severity (0 emergency ... 7 debug) to level, as in logLevels.txt
+
+static const int severityLevels[8] = { 7, 6, 6, 5, 4, 3, 3, 2 };
+
+
+int SyslogLogReader::Parse(std::string_view _msg, std::string_view &_text, std::string &_buffer)
+{
+	// Some senders terminate the message
+	while(_msg.empty() == false && (_msg.back() == '\n' || _msg.back() == '\r' || _msg.back() == '\0'))
+		_msg.remove_suffix(1);
+
+	_text = _msg;
+
+	// <PRI>: facility * 8 + severity, up to 191
+	const size_t gt = (_msg.size() > 2 && _msg[0] == '<') ? _msg.find('>', 1) : std::string_view::npos;
+
+	if(gt == std::string_view::npos || gt < 2 || gt > 4)
+		return -1;
+
+	int pri = 0;
+
+	for(size_t i = 1; i < gt; ++i)
+	{
+		if(_msg[i] < '0' || _msg[i] > '9')
+			return -1;
+		pri = pri * 10 + (_msg[i] - '0');
+	}
+
+	if(pri > 191)
+		return -1;
+
+	const int level = severityLevels[pri & 7];
+	std::string_view rest = _msg.substr(gt + 1);
+
+	_text = rest;
+
+	// RFC 3164 (also what the C library sends to /dev/log): time host tag: message, shown as it is
+	if(rest.size() < 2 || rest[0] != '1' || rest[1] != ' ')
+		return level;
+
+	// RFC 5424: 1 TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG; "-" is a missing field
+	rest.remove_prefix(2);
+
+	std::string_view field[5];
+
+	for(std::string_view &f : field)
+	{
+		const size_t sp = rest.find(' ');
+		f = rest.substr(0, sp);
+		rest = (sp == std::string_view::npos) ? std::string_view() : rest.substr(sp + 1);
+	}
+
+	// Structured data: "-", or [id param="value"...] elements, where \] does not close
+	std::string_view data;
+
+	if(rest.empty() == false && rest[0] == '[')
+	{
+		size_t i = 0;
+
+		while(i < rest.size() && rest[i] == '[')
+		{
+			for(++i; i < rest.size() && rest[i] != ']'; ++i)
+				if(rest[i] == '\\')
+					++i;
+			++i;
+		}
+
+		i = std::min(i, rest.size());
+		data = rest.substr(0, i);
+		rest.remove_prefix(i);
+	}
+	else if(rest.empty() == false && rest[0] == '-') {
+		rest.remove_prefix(1);
+	}
+
+	if(rest.empty() == false && rest[0] == ' ')
+		rest.remove_prefix(1);
+
+	// UTF-8 byte order mark
+	if(rest.substr(0, 3) == "\xEF\xBB\xBF")
+		rest.remove_prefix(3);
+
+	const std::string_view &time = field[0], &host = field[1], &app = field[2], &procId = field[3];
+
+	const auto given = [](std::string_view _f) { return _f.empty() == false && _f != "-"; };
+
+	const auto append = [&_buffer](std::string_view _s) {
+		if(_s.empty() == false)
+			_buffer.append(_buffer.empty() ? "" : " ").append(_s);
+	};
+
+	_buffer.clear();
+
+	if(given(time))
+		append(time);
+
+	if(given(host))
+		append(host);
+
+	if(given(app))
+		append(app);
+
+	if(given(procId))
+		_buffer.append(given(app) ? "[" : " [").append(procId).append("]");
+
+	if(given(app) || given(procId))
+		_buffer.append(":");
+
+	append(data);
+	append(rest);
+
+	_text = _buffer;
+
+	return level;
+}
+
+
+#ifdef POSIX
+
+int SyslogLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	fd = (_fileName.compare(0, 4, "udp:") == 0) ? OpenUdp(_fileName.substr(4)) : OpenUnix(_fileName);
+
+	if(fd < 0)
+		return err_openFailed;
+
+	// Room for bursts: a datagram finding the queue full is lost
+	int rcvBuf = 1 << 20;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+	buffer.resize(batchSize * maxMessageSize);
+	lengths.clear();
+	next = 0;
+	pos = 0;
+	level = -1;
+
+	return 0;
+}
+
+
+int SyslogLogReader::OpenUdp(const std::string &_address)
+{
+	// [HOST:]PORT
+	const size_t colon = _address.rfind(':');
+	std::string  host = (colon == std::string::npos) ? "127.0.0.1" : _address.substr(0, colon);
+	const int    port = atoi(_address.c_str() + (colon == std::string::npos ? 0 : colon + 1));
+
+	if(host == "localhost")
+		host = "127.0.0.1";
+
+	struct sockaddr_in addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(uint16_t(port));
+
+	if(port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+		std::cerr << "logviewer: warning: invalid syslog address: udp:" << _address << std::endl;
+		return -1;
+	}
+
+	const int s = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if(s < 0)
+		return -1;
+
+	if(bind(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+		close(s);
+		return -1;
+	}
+
+	return s;
+}
+
+
+int SyslogLogReader::OpenUnix(const std::string &_path)
+{
+	struct sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if(_path.empty() || _path.size() >= sizeof(addr.sun_path)) {
+		std::cerr << "logviewer: warning: invalid syslog socket path: " << _path << std::endl;
+		return -1;
+	}
+
+	std::memcpy(addr.sun_path, _path.c_str(), _path.size());
+
+	const int s = socket(AF_UNIX, SOCK_DGRAM, 0);
+
+	if(s < 0)
+		return -1;
+
+	int r = bind(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+
+	if(r != 0 && errno == EADDRINUSE)
+	{
+		// Replace the socket of a previous run, not one someone is receiving on (e.g. the system logger)
+		const int probe = socket(AF_UNIX, SOCK_DGRAM, 0);
+		struct stat st;
+
+		if(probe >= 0 && lstat(_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) &&
+		   connect(probe, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0 && errno == ECONNREFUSED)
+		{
+			unlink(_path.c_str());
+			r = bind(s, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr));
+		}
+
+		if(probe >= 0)
+			close(probe);
+	}
+
+	if(r != 0) {
+		close(s);
+		return -1;
+	}
+
+	// Any local application may log, as on /dev/log
+	chmod(_path.c_str(), 0666);
+	socketPath = _path;
+
+	return s;
+}
+
+
+void SyslogLogReader::Close()
+{
+	if(fd >= 0)
+		close(fd);
+
+	if(socketPath.empty() == false)
+		unlink(socketPath.c_str());
+
+	fd = -1;
+	socketPath.clear();
+}
+
+
+int SyslogLogReader::Receive()
+{
+	lengths.clear();
+	next = 0;
+
+#ifdef __linux__
+	struct mmsghdr msgs[batchSize];
+	struct iovec   iovs[batchSize];
+
+	for(size_t i = 0; i < batchSize; ++i)
+	{
+		iovs[i].iov_base = buffer.data() + i * maxMessageSize;
+		iovs[i].iov_len = maxMessageSize;
+
+		std::memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int n;
+
+	do {
+		n = recvmmsg(fd, msgs, unsigned(batchSize), MSG_DONTWAIT, nullptr);
+	} while(n < 0 && errno == EINTR);
+
+	for(int i = 0; i < n; ++i)
+		lengths.push_back(msgs[i].msg_len);
+#else
+	while(lengths.size() < batchSize)
+	{
+		const ssize_t len = recv(fd, buffer.data() + lengths.size() * maxMessageSize, maxMessageSize, MSG_DONTWAIT);
+
+		if(len < 0 && errno == EINTR)
+			continue;
+
+		if(len < 0)
+			break;
+
+		lengths.push_back(size_t(len));
+	}
+#endif
+
+	return int(lengths.size());
+}
+
+
+bool SyslogLogReader::GetLine(std::string_view &_line)
+{
+	if(fd < 0)
+		return false;
+
+	// Messages with no text are skipped: an empty line would end the reading round
+	do {
+		if(next == lengths.size() && Receive() == 0)
+			return false;
+
+		const std::string_view msg(buffer.data() + next * maxMessageSize, lengths[next]);
+
+		pos += std::streamoff(msg.size());
+		++next;
+
+		level = Parse(msg, _line, line);
+	} while(_line.empty());
+
+	_line = Cut(_line);
+
+	return true;
+}
+
+
+std::vector<int> SyslogLogReader::PollFds() const
+{
+	return fd >= 0 ? std::vector<int>(1, fd) : std::vector<int>();
+}
+
+#else // no sockets
+
+int SyslogLogReader::Open(const std::string &)
+{
+	static bool warned = false;
+
+	if(warned == false)
+		std::cerr << "logviewer: error: receiving syslog messages is not available on this platform." << std::endl;
+
+	warned = true;
+	return err_openFailed;
+}
+
+int  SyslogLogReader::OpenUdp(const std::string &) { return -1; }
+int  SyslogLogReader::OpenUnix(const std::string &) { return -1; }
+void SyslogLogReader::Close() {}
+int  SyslogLogReader::Receive() { return 0; }
+bool SyslogLogReader::GetLine(std::string_view &) { return false; }
+std::vector<int> SyslogLogReader::PollFds() const { return std::vector<int>(); }
+
+#endif // POSIX
+
+
+} // log_viewer
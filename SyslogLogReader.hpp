@@ -0,0 +1,95 @@
+/******************************************************************************
+ * SyslogLogReader.hpp
+ *
+ * Input layer: receive syslog messages (RFC 3164, RFC 5424) directly from
+ * the applications, on a Unix datagram socket or a localhost UDP port
+ * (--syslog).
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef SYSLOG_LOG_READER_HPP
+#define SYSLOG_LOG_READER_HPP
+
+#include "LogReader.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class SyslogLogReader : public LogReader
+{
+	/** Address (the "file name"):
+	 *		udp:PORT, udp:HOST:PORT		UDP, on 127.0.0.1 if HOST is omitted
+	 *		anything else				path of a Unix datagram socket, e.g. /tmp/app.log.sock
+	 *	A socket file left by a previous run is replaced, one in use is not.
+	 *
+	 *	Each message is a line. Its level comes from the severity in <PRI>,
+	 *	mapped as in logLevels.txt; the header of an RFC 5424 message is
+	 *	shortened to the form of RFC 3164 (time host app[pid]: message).
+	 *	The messages waiting on the socket are received in batches, with a
+	 *	single recvmmsg() on Linux.
+	 */
+
+public:
+	~SyslogLogReader() override            { Close(); }
+
+	int  Open(const std::string &_fileName) override;		// bind to the address _fileName
+	void Close() override;
+	bool IsOpen() const override           { return fd >= 0; }
+
+	bool GetLine(std::string_view &_line) override;
+	int  Level() const override            { return level; }
+
+	std::streamoff Tell() const override   { return pos; }
+	int            Seek(std::streamoff _pos) override { return _pos == Tell() ? 0 : err_seekFailed; }
+	std::streamoff Size() override         { return pos; }		// received so far
+
+	void Clear() override                  {}
+
+	size_t ReadBlock(std::streamoff, size_t, const char*&) override { return 0; }
+	bool   Seekable() const override       { return false; }
+
+	std::vector<int> PollFds() const override;
+
+	int CheckFile(const std::string&) override { return file_unchanged; }
+
+	const char* Type() const override      { return "syslog"; }
+
+	// Text of a message to show, and its level; -1 without a valid <PRI>.
+	// _text may refer to _msg or to _buffer
+	static int Parse(std::string_view _msg, std::string_view &_text, std::string &_buffer);
+
+	static const size_t maxMessageSize = 8192;		// longer messages are truncated
+	static const size_t batchSize = 64;				// messages per receive
+
+private:
+	int OpenUdp(const std::string &_address);
+	int OpenUnix(const std::string &_path);
+	int Receive();		// the messages already waiting, without blocking; return their number
+
+	int          fd = -1;
+	std::string  socketPath;		// bound by Open(), removed by Close()
+
+	std::vector<char>    buffer;	// batchSize messages of maxMessageSize bytes
+	std::vector<size_t>  lengths;	// of the received messages
+	size_t               next = 0;	// next message to return
+
+	std::string     line;
+	int             level = -1;
+	std::streamoff  pos = 0;		// bytes received
+};
+
+
+} // log_viewer
+
+
+#endif // SYSLOG_LOG_READER_HPP
@@ -0,0 +1,439 @@
+/******************************************************************************
+ * TagScan.cpp
+ *
+ * Search of a set of tags (e.g. the level tags) in a log, in a single pass:
+ * with SIMD instructions where available, with an Aho-Corasick automaton
+ * otherwise.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "TagScan.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <queue>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define TAG_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace log_viewer {
+
+
+static unsigned char Fold(unsigned char _c)
+{
+	return (_c >= 'a' && _c <= 'z') ? _c - ('a' - 'A') : _c;
+}
+
+
+void TagHit::Merge(const TagHit &_other)
+{
+	if(_other.value > value) {
+		value = _other.value;
+		best = _other.best;
+	}
+	else if(_other.value == value && _other.best >= 0 && _other.best < best) {
+		best = _other.best;
+	}
+
+	if(_other.first >= 0 && (first < 0 || _other.first < first))
+		first = _other.first;
+}
+
+
+/// TagAutomaton
+
+void TagAutomaton::Set(const std::vector<std::string> &_tags, const std::vector<int> &_values, bool _ignoreCase)
+{
+	// Columns: one per byte used by the tags, plus column 0 for all the others
+	std::memset(classOf, 0, sizeof(classOf));
+	nClasses = 1;
+
+	const auto fold = [_ignoreCase](char _c) {
+		return _ignoreCase ? Fold(static_cast<unsigned char>(_c)) : static_cast<unsigned char>(_c);
+	};
+
+	for(const std::string &tag : _tags)
+		for(char c : tag)
+			if(classOf[fold(c)] == 0)
+				classOf[fold(c)] = uint8_t(nClasses++);
+
+	if(_ignoreCase)
+		for(unsigned c = 'a'; c <= 'z'; ++c)
+			classOf[c] = classOf[Fold(static_cast<unsigned char>(c))];
+
+	// Trie of the tags; -1 is a missing transition
+	next.assign(nClasses, -1);
+	out.assign(1, TagHit());
+	all = TagHit();
+
+	for(size_t t = 0; t < _tags.size(); ++t)
+	{
+		int32_t s = 0;
+
+		for(char c : _tags[t])
+		{
+			const size_t cell = size_t(s) * nClasses + classOf[fold(c)];
+
+			if(next[cell] < 0) {
+				next[cell] = int32_t(out.size());
+				out.push_back(TagHit());
+				next.resize(next.size() + nClasses, -1);
+			}
+
+			s = next[cell];
+		}
+
+		TagHit hit;
+		hit.value = _values[t];
+		hit.best = hit.first = int(t);
+
+		out[size_t(s)].Merge(hit);
+		all.Merge(hit);
+	}
+
+	// Breadth first, the failure link of a state is complete before its children:
+	// the missing transitions become the ones of the failure state, and the tags
+	// ending there are also found here
+	std::vector<int32_t> fail(out.size(), 0);
+	std::queue<int32_t>  states;
+
+	for(size_t c = 0; c < nClasses; ++c)
+	{
+		if(next[c] < 0)
+			next[c] = 0;
+		else
+			states.push(next[c]);
+	}
+
+	while(states.empty() == false)
+	{
+		const int32_t s = states.front();
+		states.pop();
+
+		out[size_t(s)].Merge(out[size_t(fail[size_t(s)])]);
+
+		for(size_t c = 0; c < nClasses; ++c)
+		{
+			int32_t &t = next[size_t(s) * nClasses + c];
+			const int32_t f = next[size_t(fail[size_t(s)]) * nClasses + c];
+
+			if(t < 0) {
+				t = f;
+			}
+			else {
+				fail[size_t(t)] = f;
+				states.push(t);
+			}
+		}
+	}
+}
+
+
+TagHit TagAutomaton::Find(std::string_view _text, bool _firstOnly) const
+{
+	// An empty tag is found in any text
+	TagHit hit = out[0];
+
+	const int32_t *table = next.data();
+	const size_t   n = nClasses;
+	size_t         s = 0;
+
+	for(char c : _text)
+	{
+		s = size_t(table[s * n + classOf[static_cast<unsigned char>(c)]]);
+
+		if(out[s].first < 0)
+			continue;
+
+		hit.Merge(out[s]);
+
+		if(_firstOnly ? hit.first == all.first : (hit.value == all.value && hit.best == all.best))
+			break;
+	}
+
+	return hit;
+}
+
+
+/// TagMatcher
+
+void TagMatcher::Set(const std::vector<std::string> &_tags, const std::vector<int> &_values, bool _ignoreCase)
+{
+	ignoreCase = _ignoreCase;
+	tags.clear();
+	empty = all = TagHit();
+	maxLength = 0;
+
+	const uint8_t caseBit = _ignoreCase ? 0x20 : 0;
+
+	for(size_t t = 0; t < _tags.size(); ++t)
+	{
+		Tag tag;
+		tag.hit.value = _values[t];
+		tag.hit.best = tag.hit.first = int(t);
+
+		all.Merge(tag.hit);
+
+		if(_tags[t].empty()) {
+			empty.Merge(tag.hit);
+			continue;
+		}
+
+		tag.text = _tags[t];
+
+		if(_ignoreCase)
+			for(char &c : tag.text)
+				c = char(Fold(static_cast<unsigned char>(c)));
+
+		tag.first = uint8_t(tag.text.front()) | caseBit;
+		tag.last = uint8_t(tag.text.back()) | caseBit;
+
+		maxLength = std::max(maxLength, tag.text.size());
+		tags.push_back(tag);
+	}
+
+	kernel = kernel_automaton;
+
+	if(Use(kernel_avx2) == false)
+		Use(kernel_sse2);
+
+	// Also for the short texts, where setting up the vectors costs more than the search
+	automaton.Set(_tags, _values, _ignoreCase);
+}
+
+
+bool TagMatcher::Use(Kernel _kernel)
+{
+	if(_kernel != kernel_automaton)
+	{
+#ifdef TAG_SCAN_X86
+		if(tags.size() > maxVectorTags || maxLength > maxVectorLength)
+			return false;
+
+		__builtin_cpu_init();
+
+		if(_kernel == kernel_avx2 && __builtin_cpu_supports("avx2") == false)
+			return false;
+#else
+		return false;
+#endif
+	}
+
+	kernel = _kernel;
+
+	return true;
+}
+
+
+TagHit TagMatcher::Find(std::string_view _text, bool _firstOnly) const
+{
+	const Stop stop = _firstOnly ? stop_first : stop_best;
+
+	if(_text.size() < minVectorText)
+		return automaton.Find(_text, _firstOnly);
+
+	switch(kernel) {
+	case kernel_avx2: return ScanAvx2(_text, stop);
+	case kernel_sse2: return ScanSse2(_text, stop);
+	default:          return automaton.Find(_text, _firstOnly);
+	}
+}
+
+
+bool TagMatcher::Any(std::string_view _text) const
+{
+	if(_text.size() < minVectorText)
+		return automaton.Find(_text, true).first >= 0;
+
+	switch(kernel) {
+	case kernel_avx2: return ScanAvx2(_text, stop_any).first >= 0;
+	case kernel_sse2: return ScanSse2(_text, stop_any).first >= 0;
+	default:          return automaton.Find(_text, true).first >= 0;
+	}
+}
+
+
+bool TagMatcher::Verify(const Tag &_tag, const char *_at) const
+{
+	if(ignoreCase == false)
+		return std::memcmp(_at, _tag.text.data(), _tag.text.size()) == 0;
+
+	for(size_t i = 0; i < _tag.text.size(); ++i)
+		if(Fold(static_cast<unsigned char>(_at[i])) != static_cast<unsigned char>(_tag.text[i]))
+			return false;
+
+	return true;
+}
+
+
+bool TagMatcher::Done(const TagHit &_hit, Stop _stop) const
+{
+	switch(_stop) {
+	case stop_best:  return _hit.value == all.value && _hit.best == all.best;
+	case stop_first: return _hit.first == all.first;
+	default:         return _hit.first >= 0;
+	}
+}
+
+
+#ifdef TAG_SCAN_X86
+
+/** The text is read in blocks of 16 (32) positions: the bytes at each position,
+ *  and for each tag the bytes where it would end. While the latter are all
+ *  inside the text, they are loaded from it; the last blocks are copied into
+ *  a buffer padded with zeros, where no candidate beyond the text can be
+ *  confirmed. A tag found is not searched again.
+ */
+
+static const size_t tailSize = 2 * 32 + 2 * TagMatcher::maxVectorLength;
+
+
+TagHit TagMatcher::ScanSse2(std::string_view _text, Stop _stop) const
+{
+	TagHit hit = empty;
+
+	if(Done(hit, _stop))
+		return hit;
+
+	const __m128i caseBits = _mm_set1_epi8(char(ignoreCase ? 0x20 : 0));
+	__m128i firsts[maxVectorTags], lasts[maxVectorTags];
+
+	for(size_t t = 0; t < tags.size(); ++t) {
+		firsts[t] = _mm_set1_epi8(char(tags[t].first));
+		lasts[t] = _mm_set1_epi8(char(tags[t].last));
+	}
+
+	const size_t n = _text.size();
+	uint32_t found = 0;
+
+	alignas(32) char tail[tailSize];
+	size_t tailPos = n;
+
+	for(size_t pos = 0; pos < n; pos += 16)
+	{
+		if(pos < tailPos && pos + 16 + maxLength - 1 > n) {
+			const size_t rest = n - pos;
+			std::memcpy(tail, _text.data() + pos, rest);
+			std::memset(tail + rest, 0, (rest + 16 - 1) / 16 * 16 + maxLength - 1 - rest);
+			tailPos = pos;
+		}
+
+		const char *block = (pos < tailPos) ? _text.data() + pos : tail + (pos - tailPos);
+		const __m128i begins = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block)), caseBits);
+
+		for(size_t t = 0; t < tags.size(); ++t)
+		{
+			if(found & (1u << t))
+				continue;
+
+			const size_t  len = tags[t].text.size();
+			const __m128i ends = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + len - 1)), caseBits);
+
+			unsigned mask = unsigned(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(begins, firsts[t]),
+			                                                         _mm_cmpeq_epi8(ends, lasts[t]))));
+
+			for(; mask != 0; mask &= mask - 1)
+			{
+				const size_t at = pos + size_t(__builtin_ctz(mask));
+
+				if(at + len > n)
+					break;
+
+				if(Verify(tags[t], _text.data() + at)) {
+					found |= 1u << t;
+					hit.Merge(tags[t].hit);
+					if(Done(hit, _stop))
+						return hit;
+					break;
+				}
+			}
+		}
+	}
+
+	return hit;
+}
+
+
+__attribute__((target("avx2")))
+TagHit TagMatcher::ScanAvx2(std::string_view _text, Stop _stop) const
+{
+	TagHit hit = empty;
+
+	if(Done(hit, _stop))
+		return hit;
+
+	const __m256i caseBits = _mm256_set1_epi8(char(ignoreCase ? 0x20 : 0));
+	__m256i firsts[maxVectorTags], lasts[maxVectorTags];
+
+	for(size_t t = 0; t < tags.size(); ++t) {
+		firsts[t] = _mm256_set1_epi8(char(tags[t].first));
+		lasts[t] = _mm256_set1_epi8(char(tags[t].last));
+	}
+
+	const size_t n = _text.size();
+	uint32_t found = 0;
+
+	alignas(32) char tail[tailSize];
+	size_t tailPos = n;
+
+	for(size_t pos = 0; pos < n; pos += 32)
+	{
+		if(pos < tailPos && pos + 32 + maxLength - 1 > n) {
+			const size_t rest = n - pos;
+			std::memcpy(tail, _text.data() + pos, rest);
+			std::memset(tail + rest, 0, (rest + 32 - 1) / 32 * 32 + maxLength - 1 - rest);
+			tailPos = pos;
+		}
+
+		const char *block = (pos < tailPos) ? _text.data() + pos : tail + (pos - tailPos);
+		const __m256i begins = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block)), caseBits);
+
+		for(size_t t = 0; t < tags.size(); ++t)
+		{
+			if(found & (1u << t))
+				continue;
+
+			const size_t  len = tags[t].text.size();
+			const __m256i ends = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + len - 1)), caseBits);
+
+			unsigned mask = unsigned(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(begins, firsts[t]),
+			                                                               _mm256_cmpeq_epi8(ends, lasts[t]))));
+
+			for(; mask != 0; mask &= mask - 1)
+			{
+				const size_t at = pos + size_t(__builtin_ctz(mask));
+
+				if(at + len > n)
+					break;
+
+				if(Verify(tags[t], _text.data() + at)) {
+					found |= 1u << t;
+					hit.Merge(tags[t].hit);
+					if(Done(hit, _stop))
+						return hit;
+					break;
+				}
+			}
+		}
+	}
+
+	return hit;
+}
+
+#else // no x86 vector instructions
+
+TagHit TagMatcher::ScanSse2(std::string_view _text, Stop _stop) const { return automaton.Find(_text, _stop != stop_best); }
+TagHit TagMatcher::ScanAvx2(std::string_view _text, Stop _stop) const { return automaton.Find(_text, _stop != stop_best); }
+
+#endif // TAG_SCAN_X86
+
+
+} // log_viewer
@@ -0,0 +1,132 @@
+/******************************************************************************
+ * TagScan.hpp
+ *
+ * Search of a set of tags (e.g. the level tags) in a log, in a single pass:
+ * with SIMD instructions where available, with an Aho-Corasick automaton
+ * otherwise.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef TAG_SCAN_HPP
+#define TAG_SCAN_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+// Tags found in a text, as indices in the order they were given; -1 if none
+struct TagHit
+{
+	int  value = -1;		// highest value of the tags found
+	int  best = -1;			// first tag with that value
+	int  first = -1;		// first tag found
+
+	void Merge(const TagHit &_other);
+};
+
+
+class TagAutomaton
+{
+	/** The tags are compiled into a deterministic automaton, whose transitions
+	 *  already include the failure links: each byte of the log costs a table
+	 *  lookup, whatever the number of tags. With _ignoreCase, the ASCII letters
+	 *  are matched ignoring their case, without copying the log.
+	 *  Bytes not found in any tag share a single column of the table.
+	 */
+
+public:
+	TagAutomaton() { Set(std::vector<std::string>(), std::vector<int>()); }
+
+	// _values[i] is the value of _tags[i]; a negative one is never the highest
+	void Set(const std::vector<std::string> &_tags, const std::vector<int> &_values, bool _ignoreCase = true);
+
+	// The search stops as soon as the result is known: with _firstOnly, only
+	// TagHit::first is complete, otherwise only TagHit::value and TagHit::best are
+	TagHit Find(std::string_view _text, bool _firstOnly = false) const;
+
+	size_t NStates() const { return out.size(); }
+
+private:
+	size_t                nClasses = 1;
+	uint8_t               classOf[256];		// byte (case folded) to column of the table
+	std::vector<int32_t>  next;				// state * nClasses + class to state
+	std::vector<TagHit>   out;				// tags ending in each state, with their suffixes
+	TagHit                all;				// of all the tags
+};
+
+
+class TagMatcher
+{
+	/** Up to maxVectorTags tags, of up to maxVectorLength bytes, are searched
+	 *  with AVX2 (32 bytes at a time) or SSE2 (16 bytes), as the processor
+	 *  allows: the positions where the first and the last byte of a tag match
+	 *  are candidates, and only those are compared with the whole tag. Case is
+	 *  ignored by folding the bytes of the log on the fly.
+	 *  Larger sets, processors without these instructions, and short texts use
+	 *  a TagAutomaton.
+	 */
+
+public:
+	static const size_t maxVectorTags = 32;
+	static const size_t maxVectorLength = 64;
+	static const size_t minVectorText = 32;		// shorter texts go to the automaton
+
+	enum Kernel { kernel_automaton, kernel_sse2, kernel_avx2 };
+
+	TagMatcher() { Set(std::vector<std::string>(), std::vector<int>()); }
+
+	// As TagAutomaton::Set()
+	void Set(const std::vector<std::string> &_tags, const std::vector<int> &_values, bool _ignoreCase = true);
+
+	// As TagAutomaton::Find()
+	TagHit Find(std::string_view _text, bool _firstOnly = false) const;
+
+	// Whether any of the tags is in _text
+	bool Any(std::string_view _text) const;
+
+	// Search with _kernel instead of the fastest one (e.g. to compare them);
+	// false if it is not available here, or not for these tags
+	bool Use(Kernel _kernel);
+
+	Kernel Used() const { return kernel; }
+
+private:
+	enum Stop { stop_best, stop_first, stop_any };
+
+	struct Tag
+	{
+		std::string  text;			// case folded
+		TagHit       hit;			// of this tag alone
+		uint8_t      first, last;	// bytes compared by the vector instructions, folded as the log
+	};
+
+	TagHit ScanSse2(std::string_view _text, Stop _stop) const;
+	TagHit ScanAvx2(std::string_view _text, Stop _stop) const;
+
+	bool Verify(const Tag &_tag, const char *_at) const;		// the whole tag is at _at
+	bool Done(const TagHit &_hit, Stop _stop) const;			// the result cannot change any more
+
+	Kernel            kernel = kernel_automaton;
+	bool              ignoreCase = true;
+	std::vector<Tag>  tags;			// the ones not empty
+	TagHit            empty;		// of the empty tags, found in any text
+	TagHit            all;			// of all the tags
+	size_t            maxLength = 0;
+	TagAutomaton      automaton;
+};
+
+
+} // log_viewer
+
+
+#endif // TAG_SCAN_HPP
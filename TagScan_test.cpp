@@ -0,0 +1,172 @@
+/// TagScan_test.cpp
+
+/**
+	Test of the log_viewer::TagMatcher kernels (automaton, SSE2, AVX2): on
+	random logs, each one must find the same tags as a plain search, with
+	tags across the 16 and 32 byte blocks, texts shorter than
+	TagMatcher::minVectorText, case folding, empty tags, and more tags than
+	TagMatcher::maxVectorTags.
+ */
+
+#ifdef TAGSCAN_TEST
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "TagScan.hpp"
+
+
+namespace {
+
+using namespace std;
+using namespace log_viewer;
+
+// Letters of both cases, and bytes differing from a letter only in the case bit
+const char alphabet[] = "aAbBeEzZ@`[{_ \x7f\xe9\xc9\0";
+const size_t alphabetSize = sizeof(alphabet) - 1;
+
+
+char Fold(char _c)
+{
+	return (_c >= 'a' && _c <= 'z') ? char(_c - ('a' - 'A')) : _c;
+}
+
+
+bool Contains(const string &_text, const string &_tag, bool _ignoreCase)
+{
+	for(size_t i = 0; i + _tag.size() <= _text.size(); ++i)
+	{
+		size_t k = 0;
+
+		while(k < _tag.size() &&
+		      (_ignoreCase ? Fold(_text[i + k]) == Fold(_tag[k]) : _text[i + k] == _tag[k]))
+			++k;
+
+		if(k == _tag.size())
+			return true;
+	}
+
+	return false;
+}
+
+
+// The expected result, tag by tag
+TagHit Search(const string &_text, const vector<string> &_tags, const vector<int> &_values, bool _ignoreCase)
+{
+	TagHit hit;
+
+	for(size_t t = 0; t < _tags.size(); ++t)
+	{
+		if(Contains(_text, _tags[t], _ignoreCase)) {
+			TagHit tag;
+			tag.value = _values[t];
+			tag.best = tag.first = int(t);
+			hit.Merge(tag);
+		}
+	}
+
+	return hit;
+}
+
+
+string Random(mt19937 &_rnd, size_t _size)
+{
+	string text;
+
+	for(size_t i = 0; i < _size; ++i)
+		text += alphabet[_rnd() % alphabetSize];
+
+	return text;
+}
+
+} // anonymous
+
+
+int TagScan_test()
+{
+	const TagMatcher::Kernel kernels[] = { TagMatcher::kernel_automaton, TagMatcher::kernel_sse2, TagMatcher::kernel_avx2 };
+	const char *kernelNames[] = { "automaton", "SSE2", "AVX2" };
+
+	mt19937 rnd(2019);
+	int nErrors = 0;
+
+	const auto check = [&](bool _ok, const string &_what) {
+		if(_ok == false && ++nErrors <= 10)
+			cout << "TagScan test: " << _what << " - FAILED" << endl;
+	};
+
+	for(int round = 0; round < 3000; ++round)
+	{
+		// Some empty tags, some long ones, and sometimes more than maxVectorTags
+		const size_t nTags = rnd() % (round % 10 == 0 ? 2 * TagMatcher::maxVectorTags : 10);
+		const bool ignoreCase = rnd() % 3 != 0;
+
+		vector<string> tags;
+		vector<int> values;
+		size_t nSearched = 0;		// the empty tags are in any text, and not searched
+
+		for(size_t t = 0; t < nTags; ++t) {
+			tags.push_back(Random(rnd, rnd() % 20 == 0 ? rnd() % 80 : rnd() % 6));
+			values.push_back(int(rnd() % 9) - 1);
+			nSearched += tags.back().empty() ? 0 : 1;
+		}
+
+		TagMatcher matcher;
+		matcher.Set(tags, values, ignoreCase);
+
+		if(nSearched > TagMatcher::maxVectorTags)
+			check(matcher.Use(TagMatcher::kernel_sse2) == false && matcher.Use(TagMatcher::kernel_avx2) == false,
+			      "no vector kernel for more than maxVectorTags tags");
+
+		for(int n = 0; n < 30; ++n)
+		{
+			// Lengths around the 16 and 32 byte blocks, and below minVectorText
+			const size_t block = (n % 2 == 0) ? 16 : 32;
+			const size_t size = (n % 3 == 0) ? rnd() % 300 : block * (1 + rnd() % 4) + rnd() % 3 - 1;
+
+			string text = Random(rnd, size);
+
+			// A tag, in another case, ending or starting at the edge of a block
+			if(nTags > 0 && text.size() > block && n % 4 != 0)
+			{
+				string tag = tags[rnd() % nTags];
+
+				for(char &c : tag)
+					if(rnd() % 2 && c >= 'a' && c <= 'z')
+						c = Fold(c);
+
+				const size_t edge = block * (1 + rnd() % (text.size() / block));
+				const size_t at = (rnd() % 2 == 0 && edge >= tag.size()) ? edge - tag.size() + rnd() % 2 : edge - rnd() % 2;
+
+				if(at + tag.size() <= text.size())
+					text.replace(at, tag.size(), tag);
+			}
+
+			const TagHit expected = Search(text, tags, values, ignoreCase);
+
+			for(size_t k = 0; k < 3; ++k)
+			{
+				if(matcher.Use(kernels[k]) == false)
+					continue;
+
+				const TagHit best = matcher.Find(text);
+				const TagHit first = matcher.Find(text, true);
+				const bool any = matcher.Any(text);
+
+				check(best.value == expected.value && best.best == expected.best &&
+				      first.first == expected.first && any == (expected.first >= 0),
+				      string(kernelNames[k]) + ", " + to_string(tags.size()) + " tags, " +
+				      (ignoreCase ? "ignoring case, " : "") + to_string(text.size()) + " bytes: value/best/first " +
+				      to_string(best.value) + "/" + to_string(best.best) + "/" + to_string(first.first) + " instead of " +
+				      to_string(expected.value) + "/" + to_string(expected.best) + "/" + to_string(expected.first));
+			}
+		}
+	}
+
+	cout << "TagScan test: " << nErrors << " errors" << endl;
+
+	return nErrors;
+}
+
+#endif // TAGSCAN_TEST
@@ -0,0 +1,282 @@
+/******************************************************************************
+ * Timestamp.cpp
+ *
+ * Find and parse the timestamp of a log message.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#include "Timestamp.hpp"
+
+#include <cctype>
+#include <cstring>
+#include <ctime>
+
+
+namespace log_viewer {
+
+
+static bool IsDigit(char _c) { return _c >= '0' && _c <= '9'; }
+
+
+// Read _n digits at _s[_i]; -1 if they are not all digits
+static int Digits(std::string_view _s, size_t _i, size_t _n)
+{
+	if(_i + _n > _s.size())
+		return -1;
+
+	int val = 0;
+
+	for(size_t k = _i; k < _i + _n; ++k) {
+		if(!IsDigit(_s[k]))
+			return -1;
+		val = 10 * val + (_s[k] - '0');
+	}
+
+	return val;
+}
+
+
+// Month from its English abbreviation (1-12); 0 if not a month
+static int Month(std::string_view _s, size_t _i)
+{
+	static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+	if(_i + 3 > _s.size())
+		return 0;
+
+	for(int m = 0; m < 12; ++m)
+		if(std::strncmp(months + 3*m, _s.data() + _i, 3) == 0)
+			return m + 1;
+
+	return 0;
+}
+
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+static int64_t DaysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+	y -= m <= 2;
+	const int64_t  era = (y >= 0 ? y : y - 399) / 400;
+	const unsigned yoe = unsigned(y - era * 400);
+	const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+	const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + int64_t(doe) - 719468;
+}
+
+
+static int64_t Compose(int y, int mo, int d, int h, int mi, int s, int ms)
+{
+	if(mo < 1 || mo > 12 || d < 1 || d > 31 || h > 23 || mi > 59 || s > 60)
+		return noTimestamp;
+
+	return ((DaysFromCivil(y, unsigned(mo), unsigned(d)) * 24 + h) * 60 + mi) * 60000 + s * 1000 + ms;
+}
+
+
+// Time zone at _s[_i], after a time: Z, +HH, +HHMM, +HH:MM, or a space and +HHMM; false if none
+static bool Zone(std::string_view _s, size_t _i, int64_t &_offset)
+{
+	const auto endsAt = [&_s](size_t _k) { return _k >= _s.size() || !(IsDigit(_s[_k]) || std::isalpha(static_cast<unsigned char>(_s[_k]))); };
+
+	if(_i < _s.size() && _s[_i] == 'Z' && endsAt(_i + 1)) {
+		_offset = 0;
+		return true;
+	}
+
+	const bool spaced = _i < _s.size() && _s[_i] == ' ';
+	if(spaced)
+		++_i;
+
+	if(_i >= _s.size() || (_s[_i] != '+' && _s[_i] != '-'))
+		return false;
+
+	const int sign = (_s[_i] == '-') ? -1 : 1;
+	const int h = Digits(_s, _i + 1, 2);
+	int m = 0;
+	size_t end = _i + 3;
+
+	if(h < 0 || h > 14)
+		return false;
+
+	if(end < _s.size() && _s[end] == ':' && (m = Digits(_s, end + 1, 2)) >= 0)
+		end += 3;
+	else if((m = Digits(_s, end, 2)) >= 0)
+		end += 2;
+	else if(spaced)
+		return false;		// e.g. " -07 retries": not a zone
+	else
+		m = 0;
+
+	if(m > 59 || endsAt(end) == false)
+		return false;
+
+	_offset = sign * (h * 60 + m) * 60000;
+	return true;
+}
+
+
+// Offset from UTC of the local time _local (milliseconds since 1970-01-01, as if it were UTC)
+static int64_t LocalOffset(int64_t _local)
+{
+	// The offset changes at most every hour: the logs are mostly read in order
+	thread_local int64_t hour = -1, offset = 0;
+
+	const int64_t h = _local / 3600000;
+
+	if(h != hour)
+	{
+		hour = h;
+
+		const std::time_t t = std::time_t(h * 3600);
+		std::tm tm;
+		gmtime_r(&t, &tm);		// the fields of the local time
+		tm.tm_isdst = -1;
+
+		const std::time_t utc = std::mktime(&tm);
+		offset = (utc == std::time_t(-1)) ? 0 : int64_t(t - utc) * 1000;
+	}
+
+	return offset;
+}
+
+
+// Current year, in UTC
+static int CurrentYear(int64_t &_now)
+{
+	thread_local std::time_t checked = 0;
+	thread_local int year = 1970;
+
+	const std::time_t now = std::time(nullptr);
+	_now = int64_t(now) * 1000;
+
+	if(now / 3600 != checked / 3600)
+	{
+		checked = now;
+
+		std::tm tm;
+		gmtime_r(&now, &tm);
+		year = tm.tm_year + 1900;
+	}
+
+	return year;
+}
+
+
+// HH:MM:SS[.fff] at _s[_i]; return the position after it, 0 if not found
+static size_t Time(std::string_view _s, size_t _i, int &h, int &mi, int &s, int &ms)
+{
+	h  = Digits(_s, _i, 2);
+	mi = Digits(_s, _i + 3, 2);
+	s  = Digits(_s, _i + 6, 2);
+
+	if(h < 0 || mi < 0 || s < 0 || _s[_i + 2] != ':' || _s[_i + 5] != ':')
+		return 0;
+
+	size_t end = _i + 8;
+	ms = 0;
+
+	if(end < _s.size() && (_s[end] == '.' || _s[end] == ','))
+	{
+		int scale = 100;
+		for(++end; end < _s.size() && IsDigit(_s[end]); ++end) {
+			ms += scale * (_s[end] - '0');
+			scale /= 10;
+		}
+	}
+
+	return end;
+}
+
+
+// To UTC, with the zone at _s[_i] after the time, or as a local time
+static int64_t ToUtc(int64_t _t, std::string_view _s, size_t _i)
+{
+	if(_t == noTimestamp)
+		return noTimestamp;
+
+	int64_t offset = 0;
+
+	if(Zone(_s, _i, offset) == false)
+		offset = LocalOffset(_t);
+
+	return _t - offset;
+}
+
+
+int64_t ParseTimestamp(std::string_view _log, size_t _maxOffset)
+{
+	const size_t last = _log.size() < _maxOffset ? _log.size() : _maxOffset;
+	int h, mi, s, ms;
+	size_t end;
+
+	for(size_t i = 0; i < last; ++i)
+	{
+		if(i > 0 && IsDigit(_log[i - 1]))
+			continue;
+
+		if(IsDigit(_log[i]))
+		{
+			// 2012-08-31T21:16:53
+			const int y = Digits(_log, i, 4);
+			if(y >= 0 && i + 11 < _log.size() &&
+			   (_log[i + 4] == '-' || _log[i + 4] == '/') && _log[i + 7] == _log[i + 4] &&
+			   (_log[i + 10] == 'T' || _log[i + 10] == ' ') &&
+			   (end = Time(_log, i + 11, h, mi, s, ms)) > 0)
+			{
+				return ToUtc(Compose(y, Digits(_log, i + 5, 2), Digits(_log, i + 8, 2), h, mi, s, ms), _log, end);
+			}
+
+			// 10/Oct/2000:13:55:36
+			const int d = Digits(_log, i, 2);
+			const int m = Month(_log, i + 3);
+			if(d >= 0 && m > 0 && i + 12 < _log.size() &&
+			   _log[i + 2] == '/' && _log[i + 6] == '/' && _log[i + 11] == ':' &&
+			   (end = Time(_log, i + 12, h, mi, s, ms)) > 0)
+			{
+				return ToUtc(Compose(Digits(_log, i + 7, 4), m, d, h, mi, s, ms), _log, end);
+			}
+		}
+		else if(const int m = Month(_log, i))
+		{
+			// Mar  7 16:02:00 [2004]
+			size_t k = i + 3;
+			while(k < _log.size() && _log[k] == ' ')
+				++k;
+
+			const size_t dayLen = (k + 1 < _log.size() && IsDigit(_log[k + 1])) ? 2 : 1;
+			const int    d = Digits(_log, k, dayLen);
+			if(k == i + 3 || d < 0 || k + dayLen + 1 >= _log.size() || _log[k + dayLen] != ' ')
+				continue;
+
+			end = Time(_log, k + dayLen + 1, h, mi, s, ms);
+			if(end == 0)
+				continue;
+
+			const int y = (end < _log.size() && _log[end] == ' ') ? Digits(_log, end + 1, 4) : -1;
+
+			if(y >= 0)
+				return ToUtc(Compose(y, m, d, h, mi, s, ms), _log, end + 5);
+
+			// Without the year: the current one, unless the date is still to come
+			int64_t now = 0;
+			const int year = CurrentYear(now);
+			const int64_t t = ToUtc(Compose(year, m, d, h, mi, s, ms), _log, end);
+
+			if(t != noTimestamp && t > now + 24 * 3600000LL)
+				return ToUtc(Compose(year - 1, m, d, h, mi, s, ms), _log, end);
+
+			return t;
+		}
+	}
+
+	return noTimestamp;
+}
+
+
+} // log_viewer
@@ -0,0 +1,44 @@
+/******************************************************************************
+ * Timestamp.hpp
+ *
+ * Find and parse the timestamp of a log message.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef TIMESTAMP_HPP
+#define TIMESTAMP_HPP
+
+#include <cstdint>
+#include <string_view>
+
+
+namespace log_viewer {
+
+
+/** Recognized formats (the first one found in the first _maxOffset characters is used):
+ *		2012-08-31T21:16:53[.123]   2012-08-31 21:16:53   2012/08/31 21:16:53
+ *		10/Oct/2000:13:55:36        (Apache access log)
+ *		Sun Mar 7 16:02:00 2004     Mar  7 16:02:00       (ctime, syslog)
+ *
+ *  A time zone after the time (Z, +02, +0200, +02:00, or " -0700" as Apache
+ *  writes it) is applied; a time without one is a local time of this machine.
+ *  A date without the year (syslog) is taken in the current year, or in the
+ *  previous one if that would put it more than a day in the future (e.g. the
+ *  December logs read in January).
+ */
+
+static const int64_t noTimestamp = -1;
+
+// Milliseconds since 1970-01-01 UTC, noTimestamp if not found
+int64_t ParseTimestamp(std::string_view _log, size_t _maxOffset = 64);
+
+
+} // log_viewer
+
+
+#endif // TIMESTAMP_HPP
@@ -0,0 +1,464 @@
+/******************************************************************************
+ * UringLogReader.cpp
+ *
+ * Input layer: read many log files through a single io_uring (Linux),
+ * with one submission for all of them.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifdef HAVE_IO_URING
+
+#include "UringLogReader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+namespace log_viewer {
+
+
+/// UringReadBatch
+
+static const unsigned ringEntries = 256;		// reads per submission
+
+
+UringReadBatch& UringReadBatch::Shared()
+{
+	static UringReadBatch batch;
+	return batch;
+}
+
+
+bool UringReadBatch::Available()
+{
+	// The kernel may not have it, or a sandbox may forbid it
+	static const bool available = (Shared().Setup() == 0);
+	return available;
+}
+
+
+UringReadBatch::~UringReadBatch()
+{
+	if(arena != nullptr)
+		munmap(arena, nSlots * slotSize);
+
+	if(sqes != nullptr)
+		munmap(sqes, sqesSize);
+
+	if(cqRing != nullptr && cqRing != sqRing)
+		munmap(cqRing, cqRingSize);
+
+	if(sqRing != nullptr)
+		munmap(sqRing, sqRingSize);
+
+	if(ringFd >= 0)
+		close(ringFd);
+}
+
+
+int UringReadBatch::Setup()
+{
+	if(ringFd >= 0)
+		return 0;
+
+	struct io_uring_params p;
+	std::memset(&p, 0, sizeof(p));
+
+	ringFd = int(syscall(__NR_io_uring_setup, ringEntries, &p));
+
+	if(ringFd < 0)
+		return -1;
+
+	sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+	// Both rings in a single mapping, where the kernel allows it
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+	sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+
+	if(sqRing == MAP_FAILED) {
+		sqRing = nullptr;
+		return -1;
+	}
+
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		cqRing = sqRing;
+	else
+		cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+
+	if(cqRing == MAP_FAILED) {
+		cqRing = nullptr;
+		return -1;
+	}
+
+	sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+	sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+
+	if(sqes == MAP_FAILED) {
+		sqes = nullptr;
+		return -1;
+	}
+
+	char *sq = static_cast<char*>(sqRing);
+	char *cq = static_cast<char*>(cqRing);
+
+	sqEntries = p.sq_entries;
+	sqHead  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+	sqTail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+	sqMask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+	sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+	cqHead  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+	cqTail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+	cqMask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+	cqes    = cq + p.cq_off.cqes;
+
+	return 0;
+}
+
+
+int UringReadBatch::Attach(UringLogReader *_reader)
+{
+	if(Setup() != 0)
+		return -1;
+
+	for(size_t s = 0; s < readers.size(); ++s)
+	{
+		if(readers[s] == nullptr) {
+			readers[s] = _reader;
+			return int(s);
+		}
+	}
+
+	if(readers.size() == nSlots && Grow() != 0)
+		return -1;
+
+	readers.push_back(_reader);
+	return int(readers.size() - 1);
+}
+
+
+void UringReadBatch::Detach(int _slot)
+{
+	if(_slot >= 0 && size_t(_slot) < readers.size())
+		readers[size_t(_slot)] = nullptr;
+}
+
+
+/// Double the arena, keeping the data of the slots; no reads are in flight here
+
+int UringReadBatch::Grow()
+{
+	const size_t newSlots = std::max<size_t>(8, 2 * nSlots);
+
+	void *p = mmap(nullptr, newSlots * slotSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if(p == MAP_FAILED)
+		return -1;
+
+	if(arena != nullptr) {
+		std::memcpy(p, arena, nSlots * slotSize);
+		munmap(arena, nSlots * slotSize);
+	}
+
+	if(fixed)
+		syscall(__NR_io_uring_register, ringFd, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+
+	arena = static_cast<char*>(p);
+	nSlots = newSlots;
+
+	// A single registered buffer: the slots are addressed within it
+	struct iovec iov = { arena, nSlots * slotSize };
+	fixed = (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, &iov, 1) == 0);
+
+	return 0;
+}
+
+
+int UringReadBatch::Enter(unsigned _toSubmit, unsigned _minComplete)
+{
+	while(true)
+	{
+		const long r = syscall(__NR_io_uring_enter, ringFd, _toSubmit, _minComplete, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+		if(r >= 0 || errno != EINTR)
+			return int(r);
+	}
+}
+
+
+int UringReadBatch::ReadAll(const UringLogReader *_caller)
+{
+	if(ringFd < 0)
+		return 0;
+
+	int nRead = 0;
+	size_t next = 0;		// next slot to consider
+
+	while(next < readers.size())
+	{
+		// Queue a read for each reader needing data, up to a full ring
+		unsigned tail = *sqTail;
+		unsigned nQueued = 0;
+
+		for(; next < readers.size() && nQueued < sqEntries; ++next)
+		{
+			UringLogReader *r = readers[next];
+
+			if(r == nullptr || r->NeedsData() == false)
+				continue;
+
+			const unsigned index = tail & *sqMask;
+			struct io_uring_sqe &sqe = static_cast<struct io_uring_sqe*>(sqes)[index];
+
+			std::memset(&sqe, 0, sizeof(sqe));
+			sqe.opcode    = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+			sqe.fd        = r->fd;
+			sqe.off       = uint64_t(r->offset);
+			sqe.addr      = reinterpret_cast<uint64_t>(Slot(int(next)) + r->end);
+			sqe.len       = unsigned(slotSize - r->end);
+			sqe.buf_index = 0;
+			sqe.user_data = next;
+
+			sqArray[index] = index;
+			++tail;
+			++nQueued;
+		}
+
+		if(nQueued == 0)
+			break;
+
+		__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+		// Submit all of them, and wait for all of them: regular files do not block for long.
+		// The kernel may take fewer than offered: the rest is offered again as reads complete,
+		// and only the reads actually submitted are waited for
+		unsigned nSubmitted = 0, nDone = 0;
+
+		while(nDone < nQueued)
+		{
+			if(nSubmitted < nQueued)
+			{
+				const int n = Enter(nQueued - nSubmitted, 0);
+
+				if(n > 0) {
+					nSubmitted += unsigned(n);
+				}
+				else if(nSubmitted == nDone) {
+					// Nothing in flight, and no more taken: withdraw the rest, read at the next call
+					__atomic_store_n(sqTail, __atomic_load_n(sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+					return nRead;
+				}
+			}
+
+			unsigned head = *cqHead;
+			const unsigned cqTailNow = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+
+			if(head == cqTailNow) {
+				if(nDone < nSubmitted && Enter(0, 1) < 0)
+					return nRead;
+				continue;
+			}
+
+			for(; head != cqTailNow; ++head, ++nDone)
+			{
+				const struct io_uring_cqe &cqe = static_cast<struct io_uring_cqe*>(cqes)[head & *cqMask];
+				UringLogReader *r = readers[size_t(cqe.user_data)];
+
+				if(r == nullptr)
+					continue;
+
+				if(cqe.res > 0) {
+					r->end += size_t(cqe.res);
+					r->offset += std::streamoff(cqe.res);
+					++nRead;
+				}
+				else {
+					r->atEof = true;		// end of the file for now, or an error
+					r->staleEof = (r != _caller);
+				}
+			}
+
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		}
+	}
+
+	return nRead;
+}
+
+
+/// UringLogReader
+
+int UringLogReader::Open(const std::string &_fileName)
+{
+	Close();
+
+	fd = open(_fileName.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if(fd < 0)
+		return err_openFailed;
+
+	slot = UringReadBatch::Shared().Attach(this);
+
+	if(slot < 0) {
+		close(fd);
+		fd = -1;
+		return err_openFailed;
+	}
+
+	struct stat st;
+	inode = (fstat(fd, &st) == 0) ? uint64_t(st.st_ino) : 0;
+
+	Seek(0);
+
+	return 0;
+}
+
+
+void UringLogReader::Close()
+{
+	if(slot >= 0)
+		UringReadBatch::Shared().Detach(slot);
+
+	if(fd >= 0)
+		close(fd);
+
+	fd = -1;
+	slot = -1;
+}
+
+
+bool UringLogReader::GetLine(std::string_view &_line)
+{
+	if(fd < 0)
+		return false;
+
+	UringReadBatch &batch = UringReadBatch::Shared();
+
+	while(true)
+	{
+		char *data = batch.Slot(slot);
+		const char *first = data + begin;
+		const char *nl = static_cast<const char*>(std::memchr(first + scanned, '\n', end - begin - scanned));
+
+		if(nl != nullptr)
+		{
+			const size_t len = size_t(nl - first);
+
+			if(longLine.empty()) {
+				_line = Cut(std::string_view(first, len));
+			}
+			else {
+				line.swap(longLine);
+				line.append(first, len);
+				longLine.clear();
+				_line = Cut(line);
+			}
+
+			begin += len + 1;
+			scanned = 0;
+			return true;
+		}
+
+		scanned = end - begin;
+
+		// The end seen by the reads of another reader may be old by now
+		if(atEof && staleEof)
+			atEof = staleEof = false;
+
+		if(atEof)
+		{
+			// A partial line stays in the slot, to be completed by the next reads
+			if((begin == end && longLine.empty()) || holdPartial)
+				return false;
+
+			// Without a new line at the end of the file, return the rest, as getline() would do
+			line.swap(longLine);
+			line.append(first, end - begin);
+			longLine.clear();
+			_line = Cut(line);
+
+			begin = end = scanned = 0;
+			return true;
+		}
+
+		// Make room: move a partial line to the front, or set aside a line longer than the slot
+		// (only its first maxLineSize bytes, if limited)
+		if(begin == 0 && end == UringReadBatch::slotSize) {
+			Collect(longLine, data, end);
+			end = 0;
+		}
+		else if(begin > 0) {
+			std::memmove(data, data + begin, end - begin);
+			end -= begin;
+			begin = 0;
+		}
+
+		scanned = end;
+
+		// One submission for all the files which need data
+		const size_t before = end;
+		batch.ReadAll(this);
+
+		if(end == before)
+			atEof = true;		// the read failed
+	}
+}
+
+
+int UringLogReader::Seek(std::streamoff _pos)
+{
+	if(_pos < 0)
+		_pos = 0;
+
+	offset = _pos;
+	begin = end = scanned = 0;
+	longLine.clear();
+	atEof = staleEof = false;
+	ResetCut();
+
+	return 0;
+}
+
+
+std::streamoff UringLogReader::Size()
+{
+	struct stat st;
+
+	if(fd < 0 || fstat(fd, &st) != 0)
+		return -1;
+
+	return std::streamoff(st.st_size);
+}
+
+
+size_t UringLogReader::ReadBlock(std::streamoff _pos, size_t _size, const char *&_block)
+{
+	block.resize(_size);
+
+	const ssize_t n = (fd >= 0) ? pread(fd, block.data(), _size, _pos) : -1;
+
+	_block = block.data();
+	return n > 0 ? size_t(n) : 0;
+}
+
+
+} // log_viewer
+
+
+#endif // HAVE_IO_URING
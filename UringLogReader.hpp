@@ -0,0 +1,137 @@
+/******************************************************************************
+ * UringLogReader.hpp
+ *
+ * Input layer: read many log files through a single io_uring (Linux),
+ * with one submission for all of them.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+#ifndef URING_LOG_READER_HPP
+#define URING_LOG_READER_HPP
+
+#ifdef HAVE_IO_URING
+
+#include "LogReader.hpp"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+namespace log_viewer {
+
+
+class UringLogReader;
+
+
+class UringReadBatch
+{
+	/** One ring for all the io_uring readers of the process, used by the reading thread.
+	 *
+	 *	Each reader has a slot in an arena of buffers registered with the kernel.
+	 *	When a reader runs out of lines, ReadAll() queues a read for every reader
+	 *	with free space in its slot and not yet at the end of its file, submits
+	 *	them together and waits for all of them: following hundreds of files
+	 *	costs one system call per round, instead of one read() per file.
+	 *	If the buffers cannot be registered (e.g. locked memory limit), the
+	 *	reads go to the same slots without being fixed.
+	 */
+
+public:
+	static const size_t slotSize = 64 << 10;		// buffer of each reader
+
+	static UringReadBatch& Shared();
+
+	// io_uring can be used: compiled in, and allowed by the kernel
+	static bool Available();
+
+	~UringReadBatch();
+
+	int   Attach(UringLogReader *_reader);		// return the slot of the reader, or -1
+	void  Detach(int _slot);
+
+	char* Slot(int _slot)  { return arena + size_t(_slot) * slotSize; }
+
+	// Read for all the readers which need data, on behalf of _caller; return the number of reads completed
+	int   ReadAll(const UringLogReader *_caller);
+
+private:
+	UringReadBatch() {}
+
+	int  Setup();
+	int  Grow();			// double the number of slots
+	int  Enter(unsigned _toSubmit, unsigned _minComplete);
+
+	int  ringFd = -1;
+	bool fixed = false;		// the arena is registered
+
+	// Rings shared with the kernel
+	void    *sqRing = nullptr, *cqRing = nullptr, *sqes = nullptr;
+	size_t   sqRingSize = 0, cqRingSize = 0, sqesSize = 0;
+	unsigned sqEntries = 0;
+	unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+	unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+	void     *cqes = nullptr;
+
+	char    *arena = nullptr;
+	size_t   nSlots = 0;
+	std::vector<UringLogReader*>  readers;		// by slot; nullptr if free
+};
+
+
+class UringLogReader : public LogReader
+{
+	/** The slot holds the data read and not yet returned as lines; a line
+	 *  longer than the slot is collected in a separate string, up to the
+	 *  maximum line size.
+	 */
+
+public:
+	~UringLogReader() override             { Close(); }
+
+	int  Open(const std::string &_fileName) override;
+	void Close() override;
+	bool IsOpen() const override           { return fd >= 0; }
+
+	bool GetLine(std::string_view &_line) override;
+
+	std::streamoff Tell() const override   { return offset - std::streamoff(end - begin + longLine.size() + skipped); }
+	int            Seek(std::streamoff _pos) override;
+	std::streamoff Size() override;
+
+	void Clear() override                  { atEof = staleEof = false; }
+
+	size_t ReadBlock(std::streamoff _pos, size_t _size, const char *&_block) override;
+
+	const char* Type() const override      { return "uring"; }
+
+private:
+	friend class UringReadBatch;
+
+	bool NeedsData() const                 { return fd >= 0 && atEof == false && end < UringReadBatch::slotSize; }
+
+	int     fd = -1;
+	int     slot = -1;
+	bool    atEof = false;				// no data at the last read, until Clear()
+	bool    staleEof = false;			// atEof set by the reads of another reader: read again before trusting it
+
+	std::streamoff  offset = 0;			// file offset of the end of the slot data
+	size_t  begin = 0, end = 0;			// data in the slot not yet returned
+	size_t  scanned = 0;				// bytes after begin already searched for a new line
+	std::string  longLine;				// beginning of a line longer than the slot
+	std::string  line;
+	std::vector<char>  block;
+};
+
+
+} // log_viewer
+
+
+#endif // HAVE_IO_URING
+
+#endif // URING_LOG_READER_HPP
@@ -21,6 +21,10 @@
 
 #include "logviewer.hpp"
 
+#ifdef RUN_INTERNAL_TESTS
+#include "RunInternalTests.h"
+#endif
+
 int main(int argc, char* argv[])
 {
 	using namespace log_viewer;
@@ -36,5 +40,6 @@ int main(int argc, char* argv[])
 
 	logViewer.Run();
 
-	exit(0);
+	// Forward the exit status of a command run with --
+	exit(logViewer.ExitStatus());
 }
@@ -12,17 +12,69 @@
 
 #include "logLevels.h"
 #include "textModeFormatting.h"
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
 #include <set>
-#include <sstream>
 
 namespace log_viewer {
 
 using namespace textModeFormatting;
 
 
+// Word _word (from 1) of a log; empty if there are fewer
+
+static std::string_view Word(std::string_view _log, int _word)
+{
+	const auto space = [](char _c) { return _c == ' ' || (_c >= '\t' && _c <= '\r'); };
+
+	const char *p = _log.data(), *end = p + _log.size();
+
+	for(int i = 1; ; ++i)
+	{
+		while(p < end && space(*p))
+			++p;
+
+		if(p == end)
+			return std::string_view();
+
+		const char *begin = p;
+
+		while(p < end && !space(*p))
+			++p;
+
+		if(i == _word)
+			return std::string_view(begin, size_t(p - begin));
+	}
+}
+
+
+// Word _column (from 1) of a log, as read by _column >> from a stream:
+// the last word if there are fewer; empty if _column < 1
+
+static std::string_view Column(std::string_view _log, int _column)
+{
+	static const char spaces[] = " \t\n\v\f\r";
+
+	std::string_view token;
+	size_t pos = 0;
+
+	for(int i = 0; i < _column; ++i)
+	{
+		const size_t begin = _log.find_first_not_of(spaces, pos);
+
+		if(begin == std::string_view::npos)
+			break;
+
+		pos = _log.find_first_of(spaces, begin);
+		token = _log.substr(begin, pos - begin);
+	}
+
+	return token;
+}
+
+
 int LogLevels::InitLogLevels()
 {
 	/* Level tag (case insensitive), Level value */
@@ -45,6 +97,8 @@ int LogLevels::InitLogLevels()
 	pickFirstTag = false;
 	warnUnknownLogLevel = false;
 
+	CompileTags();
+
 	return int(levels.size());
 }
 
@@ -77,6 +131,8 @@ int LogLevels::AddLogLevel(const TagLevel &_level)
 	levels.push_back(_level);
 	levels.back().tag = LogLevels::ToUppercase(levels.back().tag);
 
+	CompileTags();
+
 	return int(levels.size());
 }
 
@@ -111,6 +167,8 @@ int LogLevels::AddLogLevels(const std::string &_levelsFName)
 		levels.back().tag = LogLevels::ToUppercase(levels.back().tag);
 	}
 
+	CompileTags();
+
 	return int(levels.size());
 }
 
@@ -118,6 +176,8 @@ int LogLevels::AddLogLevels(const std::string &_levelsFName)
 int LogLevels::ClearLogLevels()
 {
 	levels.clear();
+	CompileTags();
+
 	return int(levels.size());
 }
 
@@ -217,7 +277,7 @@ int LogLevels::LogLevelMapping(const std::string &_tag) const
 // Return log level tag and value in a log message;
 // empty string/negative value if not found
 
-int LogLevels::FindLogLevel(const std::string &_log,
+int LogLevels::FindLogLevel(std::string_view _log,
 							std::string &_levelTag,
 							bool _pickFirstTag,
 							int _column)
@@ -226,13 +286,8 @@ int LogLevels::FindLogLevel(const std::string &_log,
 
 	if(_column >= 0)     // index based log level search
 	{
-		std::string token;
-		std::stringstream str(_log);
-		for(int i = 0; i < _column; ++i)
-			str >> token;
-
-		levelVal = GetVal(token);
-		_levelTag = token;
+		_levelTag = Column(_log, _column);
+		levelVal = GetVal(_levelTag);
 	}
 	else                 // tag based log level search
 	{
@@ -261,25 +316,47 @@ int LogLevels::FindLogLevel(const std::string &_log,
 // Return log level value in a log message;
 // negative value if not found
 
-int LogLevels::FindLogLevel(const std::string &_log,
+int LogLevels::FindLogLevel(std::string_view _log,
 							bool _pickFirstTag,
 							int _column)
 {
-	int levelVal = 0;
+	if(_column >= 0)
+		return ResolveLogLevel(FindLogLevelRaw(_log, _pickFirstTag, _column), _log, _column);
+
+	return ResolveLogLevel(FindLogLevelVal(_log, _pickFirstTag), _log, _column);
+}
+
+
+// Return the log level value in a log message, regardless of the previous logs;
+// negative value if not found. Being const, it can run on multiple threads.
 
+int LogLevels::FindLogLevelRaw(std::string_view _log,
+							   bool _pickFirstTag,
+							   int _column) const
+{
 	if(_column >= 0)     // index based log level search
 	{
-		std::string token;
-		std::stringstream str(_log);
-		for(int i = 0; i < _column; ++i)
-			str >> token;
-
-		levelVal = GetVal(token);
+		return GetVal(std::string(Column(_log, _column)));
 	}
-	else                 // tag based log level search
-	{
-		levelVal = FindLogLevelVal(_log, _pickFirstTag);
 
+	// tag based log level search, in the whole log
+	const int val = HitLevel(tagScan.Find(_log, _pickFirstTag), _pickFirstTag);
+
+	return val >= 0 ? val : err_levelNotFound;
+}
+
+
+// Complete a level returned by FindLogLevelRaw(): a log without level belongs to
+// the previous multi-line log, or gets a default level. Call it in the logs' order.
+
+int LogLevels::ResolveLogLevel(int _rawLevel,
+							   std::string_view _log,
+							   int _column)
+{
+	int levelVal = _rawLevel;
+
+	if(_column < 0)      // tag based log level search
+	{
 		if(levelVal < 0 && multiLineLogs)
 		{
 			levelVal = prevLevel;
@@ -309,56 +386,54 @@ int LogLevels::FindLogLevel(const std::string &_log,
 // Return the log level tag in a log message; empty string if not found.
 // In case of multiple levels, return the highest one.
 
-std::string LogLevels::FindLogLevelTag(const std::string &_log,
+std::string LogLevels::FindLogLevelTag(std::string_view _log,
 									   bool _pickFirstTag,
 									   int _column) const
 {
-	int val = -1, newVal = -1;
-	std::string tag;
+	const TagHit hit = tagScan.Find(_log, _pickFirstTag);
+	const int i = _pickFirstTag ? hit.first : hit.best;
 
-	const std::string log = LogLevels::ToUppercase(_log);
+	if(i < 0 || levels[size_t(i)].level < 0)
+		return std::string();
 
-	for(size_t i = 0; i < levels.size(); ++i)
-	{
-		if(log.find(levels[i].tag) != std::string::npos)
-		{
-			newVal = levels[i].level;
-			if(newVal > val) {
-				val = newVal;
-				tag = levels[i].tag;
-			}
-			if(_pickFirstTag)
-				return tag;
-		}
-	}
-
-	return tag;
+	return levels[size_t(i)].tag;
 }
 
 
 // Return the log level value in a log message; err_levelNotFound if not found.
 // In case of multiple levels, return the highest one.
 
-int LogLevels::FindLogLevelVal(const std::string &_log,
+int LogLevels::FindLogLevelVal(std::string_view _log,
 							   bool _pickFirstTag,
-							   int _column) const
+							   int _column)
 {
-	int val = -1, newVal = -1;
-
-	const std::string log = LogLevels::ToUppercase(_log);
-
-	for(size_t i = 0; i < levels.size(); ++i)
+	// Where the level usually is, first
+	if(PositionLearned())
 	{
-		if(log.find(levels[i].tag) != std::string::npos)
+		for(int word : positions)
 		{
-			newVal = levels[i].level;
-			if(newVal > val)
-				val = newVal;
-			if(_pickFirstTag)
+			const std::string_view token = Word(_log, word);
+
+			if(token.empty())
+				continue;
+
+			const int val = HitLevel(tagScan.Find(token, _pickFirstTag), _pickFirstTag);
+
+			if(val >= 0) {
+				++positionHits;
 				return val;
+			}
 		}
+
+		++positionMisses;
 	}
 
+	const TagHit hit = tagScan.Find(_log, _pickFirstTag);
+	const int val = HitLevel(hit, _pickFirstTag);
+
+	if(val >= 0 && positionState == position_learning)
+		LearnPosition(_log, hit, _pickFirstTag);
+
 	if(val >= 0)
 		return val;
 
@@ -366,12 +441,102 @@ int LogLevels::FindLogLevelVal(const std::string &_log,
 }
 
 
+// Level of the tag found: the first one or the highest one; negative if none
+
+int LogLevels::HitLevel(const TagHit &_hit, bool _pickFirstTag) const
+{
+	if(_pickFirstTag)
+		return _hit.first < 0 ? -1 : levels[size_t(_hit.first)].level;
+
+	return _hit.value;
+}
+
+
+void LogLevels::LearnLevelPosition(bool _learn)
+{
+	wordCounts.assign(maxLearnedWord + 1, 0);
+	nLearned = 0;
+	positions.clear();
+	positionHits = 0;
+	positionMisses = 0;
+
+	positionState = _learn ? position_learning : position_off;
+}
+
+
+// Count the word where the level of a log was found; after learnLogs logs, keep the
+// most frequent words, if together they have the level of nearly all the logs
+
+void LogLevels::LearnPosition(std::string_view _log, const TagHit &_hit, bool _pickFirstTag)
+{
+	const int tag = _pickFirstTag ? _hit.first : _hit.best;
+	int word = 0;
+
+	for(int w = 1; w <= maxLearnedWord; ++w)
+	{
+		const std::string_view token = Word(_log, w);
+
+		if(token.empty())
+			break;
+
+		const TagHit h = tagScan.Find(token, _pickFirstTag);
+
+		if((_pickFirstTag ? h.first : h.best) == tag) {
+			word = w;
+			break;
+		}
+	}
+
+	++wordCounts[size_t(word)];
+
+	if(++nLearned < learnLogs)
+		return;
+
+	std::vector<std::pair<int, int>> words;		// (-logs, word)
+
+	for(int w = 1; w <= maxLearnedWord; ++w)
+		if(wordCounts[size_t(w)] * 100 >= learnLogs)
+			words.push_back(std::make_pair(-wordCounts[size_t(w)], w));
+
+	std::sort(words.begin(), words.end());
+
+	int covered = 0;
+
+	for(size_t i = 0; i < words.size() && int(i) < maxPositions; ++i) {
+		positions.push_back(words[i].second);
+		covered -= words[i].first;
+	}
+
+	positionState = (covered * 10 >= learnLogs * 9) ? position_learned : position_off;
+}
+
+
+void LogLevels::CompileTags()
+{
+	std::vector<std::string> tags;
+	std::vector<int>         values;
+
+	for(const TagLevel &l : levels) {
+		tags.push_back(l.tag);
+		values.push_back(l.level);
+	}
+
+	tagScan.Set(tags, values);
+
+	// What was learned was about other tags
+	if(positionState != position_off)
+		LearnLevelPosition(true);
+}
+
+
 void LogLevels::MakeAllUppercase()
 {
 	for(size_t i = 0; i < levels.size(); ++i)
 	{
 		levels[i].tag = LogLevels::ToUppercase(levels[i].tag);
 	}
+
+	CompileTags();
 }
 
 
@@ -389,7 +554,7 @@ int LogLevels::FindIndentation()
 }
 
 
-std::string LogLevels::ToUppercase(const std::string &_str)
+std::string LogLevels::ToUppercase(std::string_view _str)
 {
 	std::string uppCase(_str);
 
@@ -13,7 +13,11 @@
 #ifndef LOGLEVELS_H
 #define LOGLEVELS_H
 
+#include "TagScan.hpp"
+
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace log_viewer {
@@ -44,6 +48,8 @@ public:
 	}
 	
 	void SetMultiLineLogs(bool multiLine = true) { multiLineLogs = multiLine; }
+	void SetPrevLevel(int _level) { prevLevel = _level; }	// level inherited by the next multi-line log
+	int  PrevLevel() const { return prevLevel; }
 
 	int InitLogLevels();
 	int InitLogLevels(const std::vector<TagLevel> &_levels);
@@ -64,25 +70,34 @@ public:
 
 	// Return log level tag and value in a log message;
 	// empty string/negative value if not found
-	int FindLogLevel(const std::string &_log, std::string &_levelTag,
+	int FindLogLevel(std::string_view _log, std::string &_levelTag,
 					 bool _pickFirstTag = false,
 					 int _column = -1);
 
 	// Return log level value in a log message;
 	// negative value if not found
-	int FindLogLevel(const std::string &_log,
+	int FindLogLevel(std::string_view _log,
 					 bool _pickFirstTag = false,
 					 int _column = -1);
 
+	// FindLogLevel() in two steps: the first one is thread safe,
+	// the second one inherits the level of the previous log, if needed
+	int FindLogLevelRaw(std::string_view _log,
+						bool _pickFirstTag = false,
+						int _column = -1) const;
+	int ResolveLogLevel(int _rawLevel,
+						std::string_view _log,
+						int _column = -1);
+
 	// Return the log level tag in a log message; empty string if not found
-	std::string FindLogLevelTag(const std::string &_log,
+	std::string FindLogLevelTag(std::string_view _log,
 								bool _pickFirstTag = false,
 								int _column = -1) const;
 
-	// Return the log level value in a log message
-	int FindLogLevelVal(const std::string &_log,
+	// Return the log level value in a log message; it may learn the level position
+	int FindLogLevelVal(std::string_view _log,
 						bool _pickFirstTag = false,
-						int _column = -1) const;
+						int _column = -1);
 
 	void EnableWarnings(bool _enable = true) {
 		warnUnknownLogLevel = _enable;
@@ -91,8 +106,30 @@ public:
 	void MakeAllUppercase();
 	int  FindIndentation();
 
+	// Tag based search with FindLogLevel()/FindLogLevelVal(): learn from the first
+	// learnLogs logs with a level the words (as with _column) where it usually is,
+	// and look there first; the level found there is taken, without searching the
+	// rest of the log, even if the whole log would give another one
+	void LearnLevelPosition(bool _learn = true);
+
+	static const int learnLogs = 2000;
+	static const int maxLearnedWord = 16;		// words further are not learned
+	static const int maxPositions = 3;
+
+	bool PositionLearned() const { return positionState == position_learned; }
+	const std::vector<int>& LevelPositions() const { return positions; }	// once learned, most frequent first
+	uint64_t PositionHits() const   { return positionHits; }
+	uint64_t PositionMisses() const { return positionMisses; }		// full searches after learning
+
 private:
+	void CompileTags();		// after any change of levels
+	int  HitLevel(const TagHit &_hit, bool _pickFirstTag) const;
+	void LearnPosition(std::string_view _log, const TagHit &_hit, bool _pickFirstTag);
+
+	enum { position_off, position_learning, position_learned };
+
 	std::vector<TagLevel> levels;
+	TagMatcher            tagScan;		// of all the level tags
 
 	bool pickFirstTag = false;			// pick the highest level tag if false
 	bool warnUnknownLogLevel = false;
@@ -101,7 +138,14 @@ private:
 	bool multiLineLogs = true;			// log messages spanning multiple lines
 	int  prevLevel = 0;					// level of the multi-line log
 
-	static std::string ToUppercase(const std::string &_str);
+	// Level position learning, by FindLogLevelVal() only: FindLogLevelRaw() may run on several threads
+	int               positionState = position_off;
+	std::vector<int>  wordCounts;			// logs with their level in each word; [0]: elsewhere
+	int               nLearned = 0;
+	std::vector<int>  positions;			// words to look at first
+	uint64_t          positionHits = 0, positionMisses = 0;
+
+	static std::string ToUppercase(std::string_view _str);
 };
 
 
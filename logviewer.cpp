@@ -13,14 +13,19 @@
 
 #include "logviewer.hpp"
 
+#include "ChildLogReader.hpp"
+#include "ShmLogReader.hpp"
 #include "textModeFormatting.h"
+#include "Timestamp.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
@@ -36,7 +41,14 @@
 	defined(BSD) || (defined (__APPLE__) && defined (__MACH__)) || defined(__bsdi__) || \
 	defined(__minix) || defined(__CYGWIN__) || defined(__FreeBSD__)
 #define POSIX 1
+#include <cerrno>
+#include <csignal>
 #include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>		// splice()
 #endif
 
 #ifdef _WIN32
@@ -63,6 +75,13 @@ using std::endl;
 namespace log_viewer {
 
 
+#ifdef POSIX
+// With --resume, a termination request ends the main loop, which saves the reading state
+static volatile std::sig_atomic_t stopRequested = 0;
+static void RequestStop(int) { stopRequested = 1; }
+#endif
+
+
 /// Ctor: Read command line parameters
 
 LogViewer::LogViewer(int argc, char *argv[])
@@ -82,6 +101,7 @@ LogViewer::LogViewer(int argc, char *argv[])
 
 LogViewer::~LogViewer()
 {
+	pipeline.Stop();
 	rdKb.~ReadKeyboard();
 	rd->~ResetDefaults();
 	cout << "logviewer stopped.\n" << endl;
@@ -93,6 +113,19 @@ LogViewer::~LogViewer()
 int LogViewer::SetDefaultValues()
 {
 	logFile = "";
+	logFiles.clear();
+	readerType = "stream";
+	childCommand.clear();
+
+	maxLineSize = 0;
+	cutLevel = -1;
+
+	reorderWindow = std::chrono::milliseconds(500);
+
+	useIndex = false;
+	indexDir = "";
+
+	checkpoint.SetFile("");
 
 	logToFile = false;
 	outLogFile = "";
@@ -117,8 +150,10 @@ int LogViewer::SetDefaultValues()
 	textParsing = false;
 
 	levelColumn = -1;
+	levelPosition = false;
 	minLevel = 1;
 	beepLevel = -1;
+	stderrLevel = -1;
 	warnUnknownLogLevel = false;
 
 	verbose = 0;
@@ -135,14 +170,24 @@ int LogViewer::SetDefaultValues()
 	newLogsOnly = false;
 	nLatest = printAll;
 	nLatestChars = printAll;
+	readRotated = false;
 
 	incStrFlag = false;
 	excStrFlag = false;
 
 	context.Erase();
 
+	distPrevLogContext = 100;
+	newLine = false;
+	nPrintedLogs = 0;
+
 	pause = std::chrono::milliseconds(1000);
 
+	followEvents = true;
+
+	nThreads = 0;
+	batch = false;
+
 	key = 0;
 
 	nLogsReload = 20;
@@ -159,9 +204,11 @@ int LogViewer::SetLogFileName(const std::string &_logFile)
 	{
 		logFile = _logFile;
 
-		if(inLogFs.is_open()) {
-			inLogFs.close();
-			inLogFs.open(logFile);
+		if(reader && reader->IsOpen()) {
+			reader->Close();
+			reader->Open(logFile);
+			if(followEvents)
+				watcher.Watch(logFile);
 		}
 	}
 
@@ -199,26 +246,27 @@ int LogViewer::Run()
 	GenerateLogHeader();
 	logLevels.SetMultiLineLogs(multiLineLogs);
 
+	if(levelPosition && (levelColumn >= 0 || textParsing)) {
+		cerr << "logviewer: warning: the level is not searched by its tags; --levelPosition will be ignored." << endl;
+		levelPosition = false;
+	}
+	else if(levelPosition && (nThreads > 0 || batch)) {
+		cerr << "logviewer: warning: the level position is learned on the main thread only; --levelPosition will be ignored with --threads or --batch." << endl;
+		levelPosition = false;
+	}
+
+	logLevels.LearnLevelPosition(levelPosition);
+
 	/// Open log file
 
 	ifstream   iCmdFs;					// file stream for the external commands
-	string     log, contextLog;
-	string     line, token;
+	string_view  line;
 	string     command;
 
 	streamoff  pos = 0;					// position of the current log
-	streamoff  lastPrintedLogPos = 0;	//+? position of the last log with level above the threshold
-	streamoff  prevLogContext = 0;		//+? cursor exploring previous logs to provide context
-
-	int  distNextLogContext = 0;		// distance of a past log from the current one
-	int  distPrevLogContext = 100;		// distance of a future log from the current one
-	bool isPostContextLog = false;		// the current log is part of the context
 
 	bool warning = true;
 
-	int  nReadLogs = 0;			// number of read logs
-	int  nPrintedLogs = 0;		// number of printed logs
-
 	// Open file for external commands
 	if(externalCtrl)
 	{
@@ -233,11 +281,6 @@ int LogViewer::Run()
 
 	/// Print log file
 
-	int  level = 0, contextLevel = 0;
-	char contextSign = ' ';
-	bool printLog = false;
-	bool newLine = false;
-
 	// Multiple output log streams for text and HTML
 
 	if(textFileOutput)
@@ -268,12 +311,27 @@ int LogViewer::Run()
 
 	PrintExtraInfo();
 
+	if(MergeInputs())
+		return RunMerge();
+
+	// Run the command, whose output is read instead of a file
+	if(childCommand.empty() == false)
+	{
+		reader.reset(new ChildLogReader(childCommand));
+		SetUpReader(*reader, true);
+
+		if(reader->Open(logFile) != 0)
+			return -1;
+	}
+
 	// Wait for the log file to be available
-	while(true)
+	while(childCommand.empty())
 	{
-		inLogFs.open(logFile);
+		// Compressed files are decoded on the fly
+		reader.reset(LogReader::Create(readerType, logFile));
+		SetUpReader(*reader, true);
 
-		if(inLogFs.is_open())
+		if(reader->Open(logFile) == 0)
 			break;
 
 		if(warning) {
@@ -285,269 +343,978 @@ int LogViewer::Run()
 		this_thread::sleep_for(pause);
 	}
 
+	if(reader->PollFds().empty() == false)
+		watcher.WatchStreams(reader->PollFds());		// new data on the standard input or from the command ends the pause
+	else if(followEvents && readerType != "shm")		// a shared memory ring wakes the reader by itself
+		watcher.Watch(logFile);
+	else
+		watcher.Disable();
+
+	// Nothing to change in the logs: copy them as they are
+	if(CanPassThrough())
+		return RunPassthrough();
+
+	if(batch && useIndex) {
+		cerr << "logviewer: warning: the index is not used by --batch." << endl;
+		useIndex = false;
+	}
+
+	if(useIndex)
+		OpenIndex();
+
+	if(batch == false)
+		StartPipeline();
+
 	WriteHeader();
 	WriteFooter();	// add footer now, so the file is readable
 
-	if(newLogsOnly)
+	if(checkpoint.IsOpen() && reader->Seekable() == false)
+	{
+		cerr << "logviewer: warning: the input is sequential (compressed, a pipe or a command); --resume will be ignored." << endl;
+		checkpoint.SetFile("");
+	}
+
+#ifdef POSIX
+	if(checkpoint.IsOpen())
+	{
+		// Without SA_RESTART: the wait for new logs is interrupted
+		struct sigaction sa;
+		std::memset(&sa, 0, sizeof(sa));
+		sa.sa_handler = RequestStop;
+		sigemptyset(&sa.sa_mask);
+
+		for(int sig : { SIGINT, SIGTERM, SIGHUP })
+			sigaction(sig, &sa, nullptr);
+	}
+#endif
+
+	if(readRotated && (logFile == LogReader::stdinName || LiveInput()))
+	{
+		cerr << "logviewer: warning: the logs do not come from a file; --rotated will be ignored." << endl;
+		readRotated = false;
+	}
+	else if(readRotated && (newLogsOnly || nLatestChars >= 0 || nLatest >= 0))
+	{
+		cerr << "logviewer: warning: --rotated reads the whole series of log files; it will be ignored with a starting position." << endl;
+		readRotated = false;
+	}
+
+	if(checkpoint.IsOpen() && ResumeFromCheckpoint() > 0)
+	{
+		// Where the previous run stopped; the starting position options do not apply
+		pos = reader->Tell();
+	}
+	else if(readRotated)
+	{
+		// The rotated files come before the current one
+		ReadRotatedLogs();
+	}
+	else if(reader->Seekable() == false && (newLogsOnly || nLatestChars >= 0 || nLatest >= 0))
+	{
+		cerr << "logviewer: warning: the input is sequential (compressed, or a pipe); it will be read from its beginning." << endl;
+	}
+	else if(newLogsOnly)
 	{
 		// Read only the logs generated from now on; discard the past
 
 		// Reposition the cursor at the end of the file
-		inLogFs.seekg(0, ios::end);
-		pos = inLogFs.tellg();
+		reader->Seek(reader->Size());
+		pos = reader->Tell();
 	}
 	else if(nLatestChars >= 0)
 	{
 		// Start reading from the last "nChars" characters
 
 		// Reposition the cursor at the end of the file, and go back n bytes
-		inLogFs.seekg(-nLatestChars, ios::end);
-		pos = inLogFs.tellg();
+		reader->Seek(reader->Size() - nLatestChars);
+		pos = reader->Tell();
 	}
 	else if(nLatest >= 0)
 	{
 		// Start reading from the last "nLatest" logs
 
-		// Reposition the cursor at the end of the file, and go back counting the new lines
+		reader->Seek(FindLatestLogs(*reader, nLatest));
+		pos = reader->Tell();
+	}
+
+	// The logs of the command on its standard error
+	ChildLogReader *child = dynamic_cast<ChildLogReader*>(reader.get());
+
+	if(batch && child != nullptr && stderrLevel >= 0)
+		cerr << "logviewer: warning: --stderrLevel is not applied by --batch." << endl;
+
+	// The logs of an application through shared memory
+	ShmLogReader *shm = dynamic_cast<ShmLogReader*>(reader.get());
+	uint64_t nDropped = 0;		// reported so far, including the logs dropped before logviewer started
 
-		inLogFs.seekg(-1, ios::end);
+	if(batch)
+		return RunBatch();
+
+	// Main loop
+
+	FileActivity activity;		// a plain file is read again only when it changes
+	bool drained = false;		// read to its end at the last round
+	bool footerDue = false;		// new logs written since the last footer
+	streamoff checkedPos = -1;	// position at the last CheckFile(), which needs to see each new position
+
+	while(true)
+	{
+		int nNewLogs = 0;
 
-		int nLogs = 0;
+		const bool due = drained == false || reader->Tell() != checkedPos ||
+		                 reader->Seekable() == false || activity.Changed(logFile);
 
-		while(inLogFs.tellg() > 0)
+		if(due)
+			checkedPos = reader->Tell();
+
+		// Follow the log file by name, across rotations and truncations
+		const int fileChange = due ? reader->CheckFile(logFile) : LogReader::file_unchanged;
+
+		if(fileChange == LogReader::file_rotated &&
+		   (reader->IsOpen() == false || reader->Tell() >= reader->Size()))
 		{
-			if(inLogFs.peek() == '\n')
-				++nLogs;
+			// The old file has been read to its end: continue with the new one from its beginning
+			if(pipeline.Running())
+				pipeline.Drain();
+
+			cout << "--- LOG FILE ROTATED ---" << endl;
+			ReopenLogFile();
+			pos = reader->Tell();
+
+			// The producer has created the ring again
+			shm = dynamic_cast<ShmLogReader*>(reader.get());
+			nDropped = 0;
+		}
+		else if(fileChange == LogReader::file_rotated)
+		{
+			activity.Invalidate();		// check the new file again after the old one
+			reader->SetHoldPartial(false);	// the old file is complete, even without a final new line
+		}
+		else if(fileChange == LogReader::file_truncated)
+		{
+			if(pipeline.Running())
+				pipeline.Drain();
+
+			cout << "--- LOG FILE TRUNCATED ---" << endl;
+			reader->Seek(0);
+			pos = reader->Tell();
+			if(useIndex)
+				OpenIndex();
+		}
+
+		drained = (due == false);
+
+		while(drained == false)
+		{
+			if(pipeline.Running() == false)
+				MoveBackToEndLogsBlock();
 
-			if(nLogs > nLatest)
+			if(useIndex)
+				SkipIndexedLogs(*reader);
+
+			const streamoff lineOffset = reader->Tell();
+
+			if(reader->GetLine(line) == false) {
+				drained = true;
 				break;
+			}
+
+			// Empty lines are skipped (only complete lines come here)
+			if(line.empty()) {
+				if(useIndex)
+					index.Extend(lineOffset, reader->Tell());
+				pos = reader->Tell();
+				continue;
+			}
+
+			// With an index, one line is one log: reuse its level
+			const size_t indexEntry = useIndex ? index.Find(lineOffset) : LogIndex::npos;
+
+			++nNewLogs;
 
-			inLogFs.seekg(-1, ios::cur);
+			const int stream = (child != nullptr) ? child->Stream() : ChildLogReader::stream_stdout;
+			int knownLevel = (indexEntry != LogIndex::npos) ? index[indexEntry].Level() : reader->Level();
+
+			// A truncated line is shown with a marker; its level may come from the part skipped
+			const size_t lineSize = line.size() + reader->Truncated();
+
+			if(reader->Truncated() > 0) {
+				if(knownLevel < 0)
+					knownLevel = cutLevel;
+				line = MarkCut(line, reader->Truncated());
+			}
+
+			if(pipeline.Running())
+			{
+				pipeline.Push(line, size_t(stream), knownLevel);
+			}
+			else
+			{
+				const int level = ProcessLine(line, knownLevel, stream == ChildLogReader::stream_stderr ? stderrLevel : -1);
+
+				// Only complete lines are indexed: a partial line will be read again
+				if(useIndex && indexEntry == LogIndex::npos && reader->Tell() > lineOffset + streamoff(lineSize))
+					index.Append(lineOffset, reader->Tell(), level, ParseTimestamp(line));
+			}
+
+			pos = reader->Tell();
+		}
+
+		if(shm != nullptr && shm->Dropped() > nDropped) {
+			if(pipeline.Running())
+				pipeline.Drain();
+
+			cout << "--- " << shm->Dropped() - nDropped << " LOGS DROPPED: THE SHARED MEMORY RING WAS FULL ---" << endl;
+			nDropped = shm->Dropped();
 		}
 
-		pos = inLogFs.tellg();
+		if(nNewLogs > 0) {
+			footerDue = true;
+
+			if(useIndex && index.Flush() == LogIndex::err_cannotWrite) {
+				cerr << "logviewer: warning: cannot write the index file; the index will not be used." << endl;
+				useIndex = false;
+			}
+		}
+
+		// The writer thread prints the logs at its own pace: the footer follows them once it has caught up
+		if(footerDue && (pipeline.Running() == false || pipeline.Idle())) {
+			WriteFooter();
+			footerDue = false;
+		}
+
+		reader->Clear();		// clear the eof state to keep reading the growing log file
+
+		// A closed pipe will not grow
+		if(reader->Ended()) {
+			if(pipeline.Running())
+				pipeline.Drain();
+			if(footerDue)
+				WriteFooter();
+			ReportLevelSearch();
+			return 0;
+		}
+
+		// A closed stream of the command is not polled any more
+		if(child != nullptr)
+			watcher.WatchStreams(child->PollFds());
+
+		// Get user commands (not from the standard input, if the logs come from there)
+		if(logFile != LogReader::stdinName)
+			ReadKeyboard(pos);
+
+		// Get external commands
+		ReadExternalCommands(pos);
+
+		if(checkpoint.IsOpen() && checkpoint.Due())
+			SaveCheckpoint();
+
+		// Take a break, until new logs are appended or a key is pressed;
+		// no break if the old file of a rotation still has to be read to its end
+		if(textParsing == false && fileChange != LogReader::file_rotated)
+		{
+			// A ring is waited for directly; short waits, so the keys are still read
+			if(shm != nullptr)
+				shm->Wait(std::min(pause, chrono::milliseconds(100)));
+			else if(watcher.Wait(pause) != FileWatcher::evt_timeout)
+				activity.Wake();
+		}
+
+#ifdef POSIX
+		if(stopRequested)
+			break;
+#endif
+
+		if(verbose) {
+			//cout << "." << flush;
+			newLine = true;
+		}
 	}
 
-	// Main loop
+	if(pipeline.Running())
+		pipeline.Drain();
+
+	SaveCheckpoint();
+	ReportLevelSearch();
+
+	rdKb.~ReadKeyboard();
+
+	stringstream report;
+	report << "\nTotal number of logs so far: " << logNumber;
+	WriteLog(report.str(), 1, logFileField);
+	WriteFooter();
+
+	return 0;
+}
+
+
+/// Exit status of the command whose logs have been shown, waiting for its end; 0 without a command
+
+int LogViewer::ExitStatus()
+{
+	ChildLogReader *child = dynamic_cast<ChildLogReader*>(reader.get());
+
+	if(childCommand.empty() == false && child == nullptr)
+		return 127;		// it could not be run
+
+	return (child != nullptr) ? child->ExitStatus() : 0;
+}
+
+
+/// The logs can be copied from the standard input to the standard output unchanged:
+/// both are pipes, all the logs are shown, and nothing is added to them (colors are omitted)
+
+bool LogViewer::CanPassThrough() const
+{
+#ifdef POSIX
+	if(logFile != LogReader::stdinName || batch)
+		return false;
+
+	struct stat in, out;
+
+	if(fstat(STDIN_FILENO, &in) != 0 || fstat(STDOUT_FILENO, &out) != 0 ||
+	   S_ISFIFO(in.st_mode) == false || S_ISFIFO(out.st_mode) == false)
+		return false;
+
+	return minLevel <= 0 && beepLevel < 0 &&
+	       incStrFlag == false && excStrFlag == false && compare.empty() &&
+	       printLogNumber == false && printLogFile == false && textParsing == false &&
+	       delimiters.find_first_not_of('\n') == std::string::npos &&
+	       consoleOutput && textFileOutput == false && htmlOutput == false && markdownOutput == false &&
+	       externalCtrl == false;
+#else
+	return false;
+#endif
+}
+
+
+/// Copy the standard input to the standard output until it is closed; in the kernel where possible
+
+int LogViewer::RunPassthrough()
+{
+#ifdef POSIX
+	if(verbose)
+		std::cerr << "logviewer: passthrough from the standard input to the standard output." << std::endl;
 
+#ifdef __linux__
 	while(true)
 	{
-		int nNewLogs = 0;
+		const ssize_t n = splice(STDIN_FILENO, nullptr, STDOUT_FILENO, nullptr, 1 << 20, SPLICE_F_MOVE | SPLICE_F_MORE);
 
-		while(!inLogFs.eof())
-		{
-			if(inLogFs.tellg() != streampos(-1))
-			{
-				MoveBackToEndLogsBlock();
+		if(n == 0)
+			return 0;
+
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EINVAL)
+				break;			// splice not supported here: copy in user space
+			return -1;
+		}
+	}
+#endif
 
-				getline(inLogFs, line);
+	std::vector<char> buffer(1 << 16);
 
-				if(line.empty())
-					break;
+	while(true)
+	{
+		const ssize_t n = read(STDIN_FILENO, buffer.data(), buffer.size());
 
-				++nReadLogs;
-				++nNewLogs;
+		if(n == 0)
+			return 0;
 
-				string::size_type pos_beg = 0, pos_end = 0;
+		if(n < 0) {
+			if(errno == EINTR)
+				continue;
+			return -1;
+		}
 
-				while(pos_beg != string::npos)
+		for(ssize_t written = 0; written < n; ) {
+			const ssize_t w = write(STDOUT_FILENO, buffer.data() + written, size_t(n - written));
+			if(w < 0 && errno != EINTR)
+				return -1;
+			written += std::max(w, ssize_t(0));
+		}
+	}
+#else
+	return -1;
+#endif
+}
+
+
+/// Main loop with multiple log files, merged on the timestamps of their logs
+
+int LogViewer::RunMerge()
+{
+	using namespace std;
+
+	streamoff  pos = 0;
+	LogMerger::Line  line;
+
+	if(useIndex) {
+		cerr << "logviewer: warning: the index is available with a single log file only; it will not be used." << endl;
+		useIndex = false;
+	}
+
+	if(readRotated) {
+		cerr << "logviewer: warning: --rotated is available with a single log file only; it will be ignored." << endl;
+		readRotated = false;
+	}
+
+	if(checkpoint.IsOpen()) {
+		cerr << "logviewer: warning: --resume is available with a single log file only; it will be ignored." << endl;
+		checkpoint.SetFile("");
+	}
+
+	// A one-shot scan reads all the files to their end before merging: no late logs to wait for
+	merger.SetWindow(batch ? chrono::milliseconds(0) : reorderWindow);
+	merger.SetMaxLineSize(maxLineSize);
+	merger.SetHoldPartial(batch == false && textParsing == false);
+
+	// The notices of the merger follow the logs already pushed to the writer thread
+	merger.SetNotify([this](const std::string &_notice) {
+		if(pipeline.Running())
+			pipeline.Drain();
+		cout << _notice << endl;
+	});
+
+	// Files not available yet are opened as soon as they appear
+	for(const string &file : logFiles)
+	{
+		if(LogMerger::IsPattern(file)) {
+			if(merger.AddPattern(file, readerType) == 0)
+				cerr << "logviewer: warning: no log files match " << file << "\nWaiting..." << endl;
+		}
+		else if(merger.AddSource(file, readerType) != 0) {
+			cerr << "logviewer: warning: cannot open the log file: " << file
+			     << "\nWaiting..." << endl;
+		}
+	}
+
+	WatchLogFiles();
+
+	StartPipeline();
+
+	WriteHeader();
+	WriteFooter();	// add footer now, so the file is readable
+
+	// Each file starts from the same point a single log file would start from
+	for(size_t i = 0; i < merger.NSources(); ++i)
+	{
+		LogReader &src = merger.Reader(i);
+
+		// Compressed files are read from their beginning
+		if(src.IsOpen() == false || src.Seekable() == false)
+			continue;
+
+		if(newLogsOnly)
+			src.Seek(src.Size());
+		else if(nLatestChars >= 0)
+			src.Seek(src.Size() - nLatestChars);
+		else if(nLatest >= 0)
+			src.Seek(src.FindLatestLogs(nLatest, logDelimiters));
+	}
+
+	// Main loop
+
+	const unsigned rescanRounds = 16;		// rounds between two scans for new files, without directory events
+	unsigned round = 0;
+	bool footerDue = false;					// new logs written since the last footer
+
+	while(true)
+	{
+		int nNewLogs = 0;
+
+		// Follow the log files by name, across rotations and truncations
+		if(merger.CheckFiles() > 0)
+			WatchLogFiles();
+
+		int nRead = 0;
+
+		do {
+			nRead = merger.Read();
+
+			while(merger.Next(line))
+			{
+				if(pipeline.Running())
+				{
+					pipeline.Push(line.text, line.source, -1, printLogFile ? string_view(merger.FileName(line.source)) : string_view());
+				}
+				else
 				{
-					pos_end = line.find_first_of(delimiters, pos_beg);
-
-					if(pos_end != string::npos)
-						if(line[pos_end] == '.') {
-							// Check it is not a decimal point
-							if(line.size() > pos_end) {
-								if(line[pos_end + 1] >= '0' && line[pos_end + 1] <= '9') {
-									// Go to the next delimiter
-									pos_end = line.find_first_of(delimiters, pos_end + 1);
-								}
-							}
-						}
-
-					if(pos_end != string::npos) {
-						log = line.substr(pos_beg, pos_end - pos_beg + 1);
-						pos_beg = pos_end + 1;
-					}
-					else {
-						log = line.substr(pos_beg);
-						pos_beg = string::npos;
-					}
-
-					++logNumber;
-
-					level = logLevels.FindLogLevel(log, !textParsing, levelColumn);
-
-					if(level < context.MinContextLevel() &&
-					   level < minLevel)
-						continue;
-
-					// To reduce disk stress, store context logs in memory
-					if(level >= context.MinContextLevel() &&
-					   level < context.MinLevelForContext() &&
-					   level < minLevel &&
-					   distPrevLogContext > context.Width())
-					{
-						context.StorePastLog(log, level, minLevel, logNumber);
-						pos = inLogFs.tellg();
-						continue;
-					}
-
-					// Check if this log's level is high enough to log the pre-context
-					if(level >= context.MinLevelForContext())
-					{
-						// Log pre-context
-
-						while(context.NPastLogs() > 0)
-						{
-							int logNumberPre = context.ExtractPastLog(contextLog);
-
-							if(printLogNumber)
-								logNumberField = logNumberPre;
-							else
-								logNumberField = -1;
-
-							contextLevel = logLevels.FindLogLevel(contextLog, !textParsing, levelColumn);
-
-							if(newLine) {
-								cout << endl;
-								newLine = false;
-							}
-
-							WriteLog(contextLog, contextLevel, logFileField, '-', logNumberField);
-
-							++nPrintedLogs;
-						}
-
-						distNextLogContext = 0;		//+?
-						prevLogContext = pos;
-					}
-
-					// Check if this log's level is high enough to log the post-context
-
-					isPostContextLog = false;
-					printLog = false;
-
-					if(level >= context.MinLevelForContext())
-						distPrevLogContext = 0;
-
-					if(level >= minLevel)
-					{
-						// Normal log
-
-						isPostContextLog = false;
-						printLog = true;
-						contextSign = ' ';
-					}
-					else if(level >= context.MinContextLevel())
-					{
-						// Post-context log
-
-						++distPrevLogContext;
-
-						if(distPrevLogContext <= context.Width())
-						{
-							isPostContextLog = true;
-							printLog = true;
-							contextSign = '+';
-						}
-					}
-
-					if(printLog)
-					{
-						if(incStrFlag) {
-							for(size_t s = 0; s < includeStrings.size(); ++s) {
-								if(log.find(includeStrings[s]) == string::npos)
-									goto nextLine;
-							}
-						}
-
-						if(excStrFlag) {
-							for(size_t s = 0; s < excludeStrings.size(); ++s) {
-								if(log.find(excludeStrings[s]) != string::npos)
-									goto nextLine;
-							}
-						}
-
-						if(compare.empty() == false)
-						{
-							for(size_t c = 0; c < compare.size(); ++c)
-							{
-								stringstream str(log);
-								for(int i = 0; i < compare[c].column; ++i)
-									str >> token;
-
-								if(compare[c].comparison == false) {	// check less than
-									if(token >= compare[c].value)
-										goto nextLine;
-								}
-								else {									// check greater than
-									if(token <= compare[c].value)
-										goto nextLine;
-								}
-							}
-						}
-
-						if(printLogNumber)
-							logNumberField = logNumber;
-						else
-							logNumberField = -1;
-
-						if(log.size() > 0)
-						{
-							if(newLine) {
-								cout << endl;
-								newLine = false;
-							}
-
-							WriteLog(log, level, logFileField, contextSign, logNumberField);
-
-							++nPrintedLogs;
-
-							if(beepLevel >= 0 && level >= beepLevel)
-								cout << char(7) << flush;	// beep
-						}
-
-						lastPrintedLogPos = pos;
-					}
+					MoveBackToEndLogsBlock();
+
+					if(printLogFile)
+						logFileField = merger.FileName(line.source);
 
+					ProcessLine(line.text);
 				}
 
-				nextLine:
-				pos = inLogFs.tellg();
+				++nNewLogs;
 			}
-		}
+		} while(nRead > 0);
 
-		if(nNewLogs > 0) {
+		// The writer thread prints the logs at its own pace: the footer follows them once it has caught up
+		if(nNewLogs > 0)
+			footerDue = true;
+
+		if(batch && pipeline.Running())
+			pipeline.Drain();
+
+		if(footerDue && (pipeline.Running() == false || pipeline.Idle())) {
 			WriteFooter();
+			footerDue = false;
 		}
 
-		inLogFs.clear();		// clear the eof state to keep reading the growing log file
+		if(batch)
+			return 0;
 
 		// Get user commands
-		ReadKeyboard(inLogFs, pos);
+		ReadKeyboard(pos);
 
 		// Get external commands
-		ReadExternalCommands(inLogFs, pos);
+		ReadExternalCommands(pos);
 
-		// Take a break
-		if(textParsing == false)
-			this_thread::sleep_for(pause);
+		// Take a break, until new logs are appended, a key is pressed, or a pending log is due;
+		// no break if the old file of a rotation still has to be read to its end
+		int events = FileWatcher::evt_timeout;
+
+		if(textParsing == false && merger.RotationPending() == false)
+			events = watcher.Wait(std::min(pause, merger.TimeToNext()));
+
+		// The files with events are checked now, whatever their back off
+		for(const std::string &file : watcher.Changed())
+			merger.Wake(file);
+
+		// Files matching the patterns: new ones are added at a directory event, or every few rounds
+		if((events & (FileWatcher::evt_created | FileWatcher::evt_moved | FileWatcher::evt_deleted)) ||
+		   ++round % rescanRounds == 0)
+			merger.Rescan();
 
 		if(verbose) {
-			//cout << "." << flush;
 			newLine = true;
 		}
 	}
 
-	rdKb.~ReadKeyboard();
+	return 0;
+}
+
+
+/// Watch all the input log files for changes
+
+int LogViewer::WatchLogFiles()
+{
+	if(followEvents == false) {
+		watcher.Disable();
+		return 0;
+	}
+
+	watcher.Unwatch();
+
+	int n = 0;
+
+	for(const std::string &file : logFiles)
+		if(LogMerger::IsPattern(file) == false && watcher.Add(file) >= 0)
+			++n;
+
+	// A single watch for all the files of each directory of the patterns
+	for(const std::string &dir : merger.Dirs())
+		if(watcher.AddDir(dir) >= 0)
+			++n;
+
+	return n;
+}
+
+
+/// Several files to merge, or a pattern matching any number of them
+
+bool LogViewer::MergeInputs() const
+{
+	return logFiles.size() > 1 || (logFiles.size() == 1 && LogMerger::IsPattern(logFiles[0]));
+}
+
+
+/// The logs come straight from their source (a command, a shared memory ring, a socket), not from a file
+
+bool LogViewer::LiveInput() const
+{
+	return childCommand.empty() == false || readerType == "shm" || readerType == "syslog";
+}
+
+
+/// Settings of a new reader: lines longer than maxLineSize are truncated, the rest skipped without
+/// being stored; when following the file, a partial last line is held until its new line arrives
+
+void LogViewer::SetUpReader(LogReader &_reader, bool _follow)
+{
+	_reader.SetMaxLineSize(maxLineSize, [this](std::string_view _part, size_t _offset) { return ScanCut(_part, _offset); });
+	_reader.SetHoldPartial(_follow && batch == false && textParsing == false);
+}
+
+
+/// Level of a truncated line: if the part kept has none, it is searched in the parts skipped,
+/// as they are read, until found; return false when no more parts are needed
+
+bool LogViewer::ScanCut(std::string_view _part, size_t _offset)
+{
+	static const size_t overlap = 64;		// longer than the level tags
+
+	if(_offset == 0) {
+		cutLevel = -1;
+		cutText.clear();
+	}
+
+	// A level in a column is at the beginning of the line
+	if(levelColumn >= 0)
+		return false;
+
+	// A tag across two parts is found with the end of the previous one
+	cutText.append(_part.data(), _part.size());
+
+	const int level = logLevels.FindLogLevelRaw(cutText, !textParsing, levelColumn);
+
+	if(level >= 0) {
+		if(_offset > 0)
+			cutLevel = level;		// the part kept is parsed as usual
+		return false;
+	}
+
+	cutText.erase(0, cutText.size() - std::min(cutText.size(), overlap));
+	return true;
+}
+
+
+/// A truncated line, with a marker at its end
+
+std::string_view LogViewer::MarkCut(std::string_view _line, size_t _truncated)
+{
+	cutLine.assign(_line.data(), _line.size());
+	cutLine.append(LogReader::CutMarker(_truncated));
+
+	return cutLine;
+}
+
+
+/// Split a line into its logs, find their levels, and print the ones passing the filters;
+/// _level >= 0 is the already known level of the line (e.g. from the index);
+/// _floor >= 0 is the minimum level of its logs (e.g. from the standard error of the command)
+
+int LogViewer::ProcessLine(std::string_view _line, int _level, int _floor)
+{
+	int    level = 0;
+	size_t pos = 0;
+	std::string_view log;
+
+	while(NextLog(_line, pos, log))
+	{
+		++logNumber;
+
+		if(_level >= 0) {
+			level = _level;
+			logLevels.SetPrevLevel(level);
+		}
+		else {
+			level = logLevels.FindLogLevel(log, !textParsing, levelColumn);
+		}
+
+		level = std::max(level, _floor);
+
+		// A log filtered out skips the rest of its line
+		if(ShowLog(log, level) == false)
+			break;
+	}
+
+	return level;
+}
+
+
+/// With --verbose, how many logs the index skipped, and how often the level was found where it was learned to be
+
+void LogViewer::ReportLevelSearch() const
+{
+	if(verbose == 0)
+		return;
+
+	std::stringstream report;
+
+	if(useIndex)
+		report << "Index: " << nIndexSkipped << " logs skipped without reading them." << std::endl;
+
+	if(levelPosition == false) {
+		cout << report.str();
+		return;
+	}
+
+	if(logLevels.PositionLearned())
+	{
+		report << "Level position: word";
+
+		for(int word : logLevels.LevelPositions())
+			report << " " << word;
+
+		report << "; " << logLevels.PositionHits() << " logs with the level there, "
+		       << logLevels.PositionMisses() << " searched in full." << std::endl;
+	}
+	else {
+		report << "Level position: not learned; all the logs searched in full." << std::endl;
+	}
+
+	cout << report.str();
+}
+
+
+/// Start the parsing and writing threads, if requested
+
+int LogViewer::StartPipeline()
+{
+	if(nThreads <= 0)
+		return 0;
+
+	if(useIndex) {
+		cerr << "logviewer: warning: the index is updated by the reading thread; --threads will be ignored." << endl;
+		nThreads = 0;
+		return 0;
+	}
+
+	return pipeline.Start(size_t(nThreads),
+	                      [this](LogPipeline::Item &_item) { ParseLine(_item); },
+	                      [this](LogPipeline::Item &_item) { WriteLine(_item); });
+}
+
+
+/// Pipeline stage on the parsing threads: split a line into its logs, and find their levels
+
+void LogViewer::ParseLine(LogPipeline::Item &_item) const
+{
+	LogPipeline::Log l;
+	size_t pos = 0;
+	std::string_view text;
+
+	while(NextLog(_item.line, pos, text))
+	{
+		l.begin = size_t(text.data() - _item.line.data());
+		l.size = text.size();
+		l.level = (_item.level >= 0) ? _item.level : logLevels.FindLogLevelRaw(text, !textParsing, levelColumn);
+		_item.logs.push_back(l);
+	}
+}
+
+
+/// Pipeline stage on the writing thread: complete the levels and print the logs, in order
+
+void LogViewer::WriteLine(LogPipeline::Item &_item)
+{
+	MoveBackToEndLogsBlock();
+
+	// The merger may change its files meanwhile: their names come with the lines
+	if(_item.file.empty() == false)
+		logFileField = _item.file;
+
+	// Without merged files, the source is the stream of the command
+	const int floor = (childCommand.empty() == false && _item.source == ChildLogReader::stream_stderr) ? stderrLevel : -1;
+
+	for(const LogPipeline::Log &l : _item.logs)
+	{
+		const std::string_view text = std::string_view(_item.line).substr(l.begin, l.size);
+
+		++logNumber;
+
+		int level = l.level;
+
+		if(_item.level >= 0)
+			logLevels.SetPrevLevel(level);
+		else
+			level = logLevels.ResolveLogLevel(level, text, levelColumn);
+
+		level = std::max(level, floor);
+
+		// A log filtered out skips the rest of its line
+		if(ShowLog(text, level) == false)
+			break;
+	}
+}
+
+
+/// Get the log starting at _pos in a line, and move _pos to the next one (npos at the end);
+/// _log refers to _line
+
+bool LogViewer::NextLog(std::string_view _line, size_t &_pos, std::string_view &_log) const
+{
+	if(_pos == std::string_view::npos)
+		return false;
+
+	const char *end = _line.data() + _line.size();
+	const char *p = splitDelimiters.FindFirst(_line.data() + _pos, end);
+
+	// A dot followed by a digit is a decimal point, not a delimiter
+	while(p != nullptr && *p == '.' && p + 1 < end && *(p + 1) >= '0' && *(p + 1) <= '9')
+		p = splitDelimiters.FindFirst(p + 1, end);
+
+	if(p != nullptr) {
+		const size_t posEnd = size_t(p - _line.data());
+		_log = _line.substr(_pos, posEnd - _pos + 1);
+		_pos = posEnd + 1;
+	}
+	else {
+		_log = _line.substr(_pos);
+		_pos = std::string_view::npos;
+	}
+
+	return true;
+}
+
+
+/// Apply context and filters to a log, and print it; false if it is filtered out.
+/// _passes is the result of PassFilters(), if already known (-1 = not known)
+
+bool LogViewer::ShowLog(std::string_view _log, int _level, int _passes)
+{
+	using namespace std;
+
+	int  contextLevel = 0;
+	char contextSign = ' ';
+	bool printLog = false;
+	bool isPostContextLog = false;		// the current log is part of the context
+
+	if(_level < context.MinContextLevel() &&
+	   _level < minLevel)
+		return true;
+
+	// To reduce disk stress, store context logs in memory
+	if(_level >= context.MinContextLevel() &&
+	   _level < context.MinLevelForContext() &&
+	   _level < minLevel &&
+	   distPrevLogContext > context.Width())
+	{
+		context.StorePastLog(_log, _level, minLevel, logNumber);
+		return true;
+	}
+
+	// Check if this log's level is high enough to log the pre-context
+	if(_level >= context.MinLevelForContext())
+	{
+		// Log pre-context
+
+		while(context.NPastLogs() > 0)
+		{
+			int logNumberPre = context.ExtractPastLog(contextLog);
+
+			if(printLogNumber)
+				logNumberField = logNumberPre;
+			else
+				logNumberField = -1;
+
+			contextLevel = logLevels.FindLogLevel(contextLog, !textParsing, levelColumn);
+
+			if(newLine) {
+				cout << endl;
+				newLine = false;
+			}
+
+			WriteLog(contextLog, contextLevel, logFileField, '-', logNumberField);
+
+			++nPrintedLogs;
+		}
+	}
+
+	// Check if this log's level is high enough to log the post-context
+
+	isPostContextLog = false;
+	printLog = false;
+
+	if(_level >= context.MinLevelForContext())
+		distPrevLogContext = 0;
+
+	if(_level >= minLevel)
+	{
+		// Normal log
+
+		isPostContextLog = false;
+		printLog = true;
+		contextSign = ' ';
+	}
+	else if(_level >= context.MinContextLevel())
+	{
+		// Post-context log
+
+		++distPrevLogContext;
+
+		if(distPrevLogContext <= context.Width())
+		{
+			isPostContextLog = true;
+			printLog = true;
+			contextSign = '+';
+		}
+	}
+
+	if(printLog)
+	{
+		if(_passes < 0 ? PassFilters(_log) == false : _passes == 0)
+			return false;
+
+		if(printLogNumber)
+			logNumberField = logNumber;
+		else
+			logNumberField = -1;
+
+		if(_log.size() > 0)
+		{
+			if(newLine) {
+				cout << endl;
+				newLine = false;
+			}
+
+			WriteLog(_log, _level, logFileField, contextSign, logNumberField);
+
+			++nPrintedLogs;
+
+			if(beepLevel >= 0 && _level >= beepLevel)
+				cout << char(7) << flush;	// beep
+		}
+	}
+
+	return true;
+}
+
+
+/// Check a log against the substrings and comparisons required by the user
+
+bool LogViewer::PassFilters(std::string_view _log) const
+{
+	using namespace std;
+
+	if(incStrFlag) {
+		for(size_t s = 0; s < includeMatchers.size(); ++s) {
+			if(includeMatchers[s].Any(_log) == false)
+				return false;
+		}
+	}
+
+	if(excStrFlag && excludeMatcher.Any(_log))
+		return false;
 
-	stringstream report("\nTotal number of logs so far: ");
-	report << logNumber;
-	WriteLog(report.str(), 1, logFileField);
-	WriteFooter();
+	if(compare.empty() == false)
+	{
+		string token;
 
-	return 0;
+		for(size_t c = 0; c < compare.size(); ++c)
+		{
+			stringstream str{string(_log)};
+			for(int i = 0; i < compare[c].column; ++i)
+				str >> token;
+
+			if(compare[c].comparison == false) {	// check less than
+				if(token >= compare[c].value)
+					return false;
+			}
+			else {									// check greater than
+				if(token <= compare[c].value)
+					return false;
+			}
+		}
+	}
+
+	return true;
 }
 
 
@@ -625,6 +1392,8 @@ void LogViewer::PrintHelp(const ProgArgs &_args, const char* _progName, LogLevel
 	cout << "\t- Free software, GPL 3 license.\n";
 	cout << "\nParameters:\n";
 	_args.Help();
+	cout << "\n\t-- command [args]\n\t\tRun the command and show the logs it writes on its standard output and error;\n"
+	     << "\t\tlogviewer exits with its exit status.\n";
 	cout << endl;
 
 	cout << "Log levels highlighting: \n";
@@ -655,6 +1424,7 @@ void LogViewer::PrintHelp(const ProgArgs &_args, const char* _progName, LogLevel
 	cout << "\t [R]       Reload all the logs and display them with the current criteria.\n";
 	cout << "\t [r]       Reload the last " << nLogsReload << " logs and display them with the current criteria.\n";
 	cout << "\t [n]       Set the number of logs to reload (default is " << nLogsReload << ").\n";
+	cout << "\t [s]       With multiple log files, show how many of them are hot (recently changed) or cold.\n";
 	cout << "\t [Q]       Exit logviewer.\n";
 
 	cout << "\nSyntax of the command file:\n";
@@ -665,12 +1435,9 @@ void LogViewer::PrintHelp(const ProgArgs &_args, const char* _progName, LogLevel
 	cout << "\n   quit           Exit the program.\n";
 	cout << "\n   Note: only one command per line.\n";
 
-	//+TEST //+TODO: Windows version
-	cout << "\n- To print multiple log files simultaneously, a script like this can be used \n"
-			"   (the temporal sequence of logs from different sources is not guaranteed):\n";
-	cout << "\t " << progName.substr(pos) << " -i file1.log -f &\n";
-	cout << "\t " << progName.substr(pos) << " -i file2.log -f &\n";
-	cout << "\t " << progName.substr(pos) << " -i file3.log -f &\n";
+	cout << "\n- To print multiple log files simultaneously, repeat the input parameter; the logs are\n"
+			"   merged on their timestamps, waiting up to --reorderWindow seconds for late logs:\n";
+	cout << "\t " << progName.substr(pos) << " -i file1.log -i file2.log -i file3.log -f\n";
 
 	cout << "\n" << string(110, '-') << "\n";
 	cout << endl;
@@ -731,10 +1498,18 @@ int LogViewer::SetCommandLineParams()
 	/* int Set(std::string _tag, std::string _shortTag, std::string _desc = "",
 			   bool _optional = true, bool _needed = false, std::string _default = "");
 	*/
-	arg.Set("--input", "-i", "Input log file name", false, true);
+	arg.Set("--input", "-i", "Input log file name; repeat it to merge multiple log files in time order; gzip and zstd files are decompressed on the fly; - reads the standard input", false, true);
+	progArgs.AddArg(arg);
+	arg.Set("--dir", "-dir", "Follow all the log files of a directory, adding the new ones as they appear; --input also accepts patterns, e.g. '/var/log/app/*.log'", true, true);
+	progArgs.AddArg(arg);
+	arg.Set("--shm", "-shm", "Read the logs an application writes to the shared memory ring with this name (see ShmLogRing.hpp), instead of a file", true, true);
+	progArgs.AddArg(arg);
+	arg.Set("--syslog", "-sys", "Receive syslog messages (RFC 3164, RFC 5424) on a Unix datagram socket (its path) or on a UDP port (udp:PORT, on localhost), instead of reading a file", true, true);
 	progArgs.AddArg(arg);
 	arg.Set("--levelCol", "-l", "ID of the column which contains the log level", true, true, "-1");
 	progArgs.AddArg(arg);
+	arg.Set("--levelPosition", "-lp", "Learn from the first logs the words where the level usually is, and take the level found there without searching the rest of the log", true, false);
+	progArgs.AddArg(arg);
 	arg.Set("--minLevel", "-m", "Minimum level a log must have to be shown", true, true, "3");
 	progArgs.AddArg(arg);
 	arg.Set("--printNewLogsOnly", "-nl", "Print the new logs only", true, false);
@@ -743,6 +1518,8 @@ int LogViewer::SetCommandLineParams()
 	progArgs.AddArg(arg);
 	arg.Set("--nLatestChars", "-nc", "Print the latest n characters only", true, true, "-1");
 	progArgs.AddArg(arg);
+	arg.Set("--rotated", "-ro", "Read first the rotated files of the log file (e.g. file.log.2.gz, file.log.1), oldest first", true, false);
+	progArgs.AddArg(arg);
 	arg.Set("--printLogFile", "-f", "Print the log file name for each message (useful if multiple log files are shown simultaneously)", true, false);
 	progArgs.AddArg(arg);
 	arg.Set("--printLogNumber", "-ln", "Print the log/line numbers", true, false);
@@ -771,6 +1548,8 @@ int LogViewer::SetCommandLineParams()
 	progArgs.AddArg(arg);
 	arg.Set("--delimiters", "-d", "Specify custom delimiters for the messages (default = new line; in case a \';\' is needed, double quote it)", true, true);
 	progArgs.AddArg(arg);
+	arg.Set("--maxLineSize", "-mls", "Maximum size (in bytes) of a line; longer lines are shown truncated, and the rest of them is skipped without being stored (e.g. 1048576; 0 = no limit)", true, true, "0");
+	progArgs.AddArg(arg);
 	arg.Set("--outFile", "-o", "Redirect the output to a file (default = standard output)", true, true);
 	progArgs.AddArg(arg);
 	arg.Set("--outFileFormat", "-of", "Format of the output log file: console, plain, HTML (TODO: markdown)", true, true);
@@ -781,7 +1560,25 @@ int LogViewer::SetCommandLineParams()
 	progArgs.AddArg(arg);
 	arg.Set("--beepLevel", "-bl", "Level above which an audio signal is produced", true, true, "-1");
 	progArgs.AddArg(arg);
-	arg.Set("--pause", "-p", "Pause (in seconds) among a check of the log file and the next", true, true, "1.0");
+	arg.Set("--stderrLevel", "-sl", "Minimum level of the logs a command (after --) writes on its standard error", true, true, "-1");
+	progArgs.AddArg(arg);
+	arg.Set("--reader", "-rd", "Input reader: stream (std::ifstream), mmap (memory mapped file, POSIX only) or uring (io_uring, Linux only; batches the reads of many files), cold or direct (one pass over large archived files, e.g. with --batch: large reads ahead, sparing the page cache; direct uses O_DIRECT)", true, true, "stream");
+	progArgs.AddArg(arg);
+	arg.Set("--index", "-ix", "Keep a sidecar index of the log file (offsets, levels, timestamps) to reload and filter faster", true, false);
+	progArgs.AddArg(arg);
+	arg.Set("--indexDir", "-ixd", "Directory for the index files (default = next to the log file; implies --index)", true, true);
+	progArgs.AddArg(arg);
+	arg.Set("--resume", "-rs", "State file: continue from where the previous run stopped; the reading position is saved there at intervals and on exit", true, true);
+	progArgs.AddArg(arg);
+	arg.Set("--follow", "-fw", "How to wait for new logs: events (file change notifications, where available) or poll", true, true, "events");
+	progArgs.AddArg(arg);
+	arg.Set("--threads", "-th", "Number of parsing threads; if > 0, logs are read, parsed and written on separate threads", true, true, "0");
+	progArgs.AddArg(arg);
+	arg.Set("--batch", "-b", "Scan the existing logs in parallel chunks (on --threads cores, or all of them), then exit", true, false);
+	progArgs.AddArg(arg);
+	arg.Set("--reorderWindow", "-rw", "With multiple log files, maximum delay (in seconds) of a log, waiting for older logs from the other files", true, true, "0.5");
+	progArgs.AddArg(arg);
+	arg.Set("--pause", "-p", "Pause (in seconds) among a check of the log file and the next; timeout when waiting for file events", true, true, "1.0");
 	progArgs.AddArg(arg);
 	arg.Set("--restore", "-res", "Restore system in case of problems");
 	progArgs.AddArg(arg);
@@ -802,7 +1599,15 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 	using std::endl;
 	using std::string;
 
-	int nUnknown = progArgs.Parse(argc, argv);
+	// The arguments after -- are a command to run, not options
+	int nArgs = 1;
+	while(nArgs < argc && string(argv[nArgs]) != "--")
+		++nArgs;
+
+	for(int i = nArgs + 1; i < argc; ++i)
+		childCommand.push_back(argv[i]);
+
+	int nUnknown = progArgs.Parse(nArgs, argv);
 
 	if(nUnknown > 0) {
 		cerr << "Warning: passed " << nUnknown << " unknown argument(s); they will be ignored." << endl;
@@ -810,10 +1615,36 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 
 	progArgs.GetValue("--input", logFile);
 
+	if(progArgs.GetValue("--input"))
+	{
+		int n = 0;
+		while(n >= 0) {
+			n = progArgs.GetValue("--input", tempStr, n);
+			if(n >= 0)
+				logFiles.push_back(tempStr);
+		}
+	}
+
+	if(progArgs.GetValue("--dir"))
+	{
+		int n = 0;
+		while(n >= 0) {
+			n = progArgs.GetValue("--dir", tempStr, n);
+			if(n >= 0)
+				logFiles.push_back(tempStr + (tempStr.empty() || tempStr.back() == '/' ? "*" : "/*"));
+		}
+
+		if(logFile.empty())
+			logFile = logFiles.front();
+	}
+
 	string levelCol;
 	if(progArgs.GetValue("--levelCol", levelCol) >= 0)
 		levelColumn = atoi(levelCol.c_str());
 
+	if(progArgs.GetValue("--levelPosition"))
+		levelPosition = true;
+
 	if(progArgs.GetValue("--text")) {
 		textParsing = true;
 		warnUnknownLogLevel = false;
@@ -832,6 +1663,10 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 		newLogsOnly = true;
 	}
 
+	if(progArgs.GetValue("--rotated")) {
+		readRotated = true;
+	}
+
 	if(progArgs.GetValue("--nLatest")) {
 		string nLogs;
 		progArgs.GetValue("--nLatest", nLogs);
@@ -893,6 +1728,14 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 		}
 	}
 
+	// Substrings searched as tags, case sensitive
+	for(const string &s : includeStrings) {
+		includeMatchers.push_back(TagMatcher());
+		includeMatchers.back().Set(std::vector<string>(1, s), std::vector<int>(1, 0), false);
+	}
+
+	excludeMatcher.Set(excludeStrings, std::vector<int>(excludeStrings.size(), 0), false);
+
 	if(progArgs.GetValue("--lessThan"))
 	{
 		int n = 0;
@@ -978,6 +1821,18 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 		beepLevel = logLevels.GetVal(level);
 	}
 
+	if(progArgs.GetValue("--stderrLevel")) {
+		string level;
+		progArgs.GetValue("--stderrLevel", level);
+		stderrLevel = logLevels.GetVal(level);
+	}
+
+	if(childCommand.empty() == false && logFiles.empty() == false) {
+		cerr << "logviewer: warning: the logs are read from the command; --input will be ignored." << endl;
+		logFiles.clear();
+		logFile = "";
+	}
+
 	if(progArgs.GetValue("--delimiters")) {
 		progArgs.GetValue("--delimiters", delimiters);
 	}
@@ -1016,6 +1871,90 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 			logLevels.EnableWarnings(true);
 	}
 
+	if(progArgs.GetValue("--reader"))
+	{
+		progArgs.GetValue("--reader", readerType);
+
+		std::unique_ptr<LogReader> check(LogReader::Create(readerType));
+
+		if(!check) {
+			std::cerr << "Warning: " << readerType << " is an invalid input reader.\n"
+			          << "              Available readers: " << LogReader::AvailableTypes() << "; the stream reader will be used." << std::endl;
+			readerType = "stream";
+		}
+		else {
+			readerType = check->Type();		// a reader not available here falls back to another one
+		}
+	}
+
+	if(progArgs.GetValue("--shm") && childCommand.empty())
+	{
+		if(logFiles.empty() == false)
+			cerr << "logviewer: warning: the logs are read from the shared memory ring; --input will be ignored." << endl;
+
+		progArgs.GetValue("--shm", logFile);
+		logFiles.assign(1, logFile);
+		readerType = "shm";
+	}
+	else if(progArgs.GetValue("--syslog") && childCommand.empty())
+	{
+		if(logFiles.empty() == false)
+			cerr << "logviewer: warning: the logs are received from syslog; --input will be ignored." << endl;
+
+		progArgs.GetValue("--syslog", logFile);
+		logFiles.assign(1, logFile);
+		readerType = "syslog";
+	}
+
+	if(progArgs.GetValue("--index")) {
+		useIndex = true;
+	}
+
+	if(progArgs.GetValue("--resume")) {
+		string stateFile;
+		progArgs.GetValue("--resume", stateFile);
+		checkpoint.SetFile(stateFile);
+	}
+
+	if(progArgs.GetValue("--indexDir")) {
+		progArgs.GetValue("--indexDir", indexDir);
+		useIndex = true;
+	}
+
+	if(progArgs.GetValue("--follow"))
+	{
+		string follow;
+		progArgs.GetValue("--follow", follow);
+
+		if(follow == "poll")
+			followEvents = false;
+		else if(follow == "events")
+			followEvents = true;
+		else
+			std::cerr << "Warning: " << follow << " is an invalid follow mode; file events will be used where available." << std::endl;
+	}
+
+	if(progArgs.GetValue("--threads")) {
+		string sThreads;
+		progArgs.GetValue("--threads", sThreads);
+		nThreads = std::max(0, atoi(sThreads.c_str()));
+	}
+
+	if(progArgs.GetValue("--batch"))
+		batch = true;
+
+	if(progArgs.GetValue("--maxLineSize")) {
+		string sSize;
+		progArgs.GetValue("--maxLineSize", sSize);
+		maxLineSize = size_t(std::max(0LL, atoll(sSize.c_str())));
+	}
+
+	if(progArgs.GetValue("--reorderWindow")) {
+		string sWindow;
+		progArgs.GetValue("--reorderWindow", sWindow);
+		reorderWindow = std::chrono::milliseconds(int(1000 * atof(sWindow.c_str())));
+	}
+
 	string sPause;
 	progArgs.GetValue("--pause", sPause);
 	float fPause = float(atof(sPause.c_str()));
@@ -1046,6 +1985,11 @@ int LogViewer::ReadCommandLineParams(int argc, char *argv[])
 	if(textParsing == false)
 		delimiters.append("\n");	// new line as default delimiter for logs
 
+	logDelimiters.Set(delimiters + "\n");	// lines are always split on new lines
+
+	// A record of a live input (shm, syslog, child command) may hold new lines of the same log
+	splitDelimiters = LiveInput() ? ByteSet(delimiters) : logDelimiters;
+
 	// Check for conflicting parameters
 
 	if(textParsing) {
@@ -1085,7 +2029,7 @@ int LogViewer::WriteHeader()
 
 /// Write the log to a set of destinations (console, HTML file, ...)
 
-int LogViewer::WriteLog(const std::string &_log, int _level, const std::string &_file, char _tag, int _logNumber)
+int LogViewer::WriteLog(std::string_view _log, int _level, const std::string &_file, char _tag, int _logNumber)
 {
 	int n = 0;
 
@@ -1145,10 +2089,44 @@ int LogViewer::WriteFooter()
 
 int LogViewer::GenerateLogHeader()
 {
-	const std::string logDate = GetLogDate(logFile);		// time the log was generated
+	const bool fromStdin = (logFile == LogReader::stdinName);
+
+	// Time the log was generated
+	std::string logDate = GetLogDate(fromStdin ? "/dev/stdin" : logFile);
 
 	std::stringstream header, tmp;
-	tmp << "Log file: " << logFile << " - " << logDate << " - "
+
+	// The logs of a command, of a ring or a socket, or of the files matching a pattern, are followed from now on
+	if(LiveInput() || LogMerger::IsPattern(logFile))
+	{
+		const time_t now = time(nullptr);
+		char mbstr[100];
+
+		if(std::strftime(mbstr, sizeof(mbstr), "%FT%T", std::localtime(&now)))
+			logDate = mbstr;
+	}
+
+	if(childCommand.empty() == false)
+	{
+		tmp << "Command:";
+		for(const std::string &arg : childCommand)
+			tmp << " " << arg;
+	}
+	else if(MergeInputs()) {
+		tmp << "Log files: ";
+		for(size_t i = 0; i < logFiles.size(); ++i)
+			tmp << (i > 0 ? ", " : "") << logFiles[i];
+	}
+	else if(readerType == "shm")
+		tmp << "Shared memory ring: " << logFile;
+	else if(readerType == "syslog")
+		tmp << "Syslog: " << logFile;
+	else if(fromStdin)
+		tmp << "Log file: standard input";
+	else
+		tmp << "Log file: " << logFile;
+
+	tmp << " - " << logDate << " - "
 	    << "LogViewer " << version << "." << subversion <<  "." << subsubversion;
 
 	logFormatter.SetTitle(tmp.str());
@@ -1248,7 +2226,25 @@ int LogViewer::PrintExtraInfo()
 		}
 	}
 
-	cout << "Interval between checks of the log file: " << pause.count()/1000 << " seconds" << endl;
+	cout << "Input reader: " << readerType << endl;
+
+	if(batch)
+		cout << "Batch scan of the existing logs, on "
+		     << (nThreads > 0 ? nThreads : int(std::thread::hardware_concurrency())) << " threads" << endl;
+	else if(nThreads > 0)
+		cout << "Threads: 1 reading, " << nThreads << " parsing, 1 writing" << endl;
+
+	if(logFiles.size() > 1)
+		cout << "Merging " << logFiles.size() << " log files on their timestamps; reorder window: "
+		     << reorderWindow.count()/1000.0 << " seconds" << endl;
+	else if(MergeInputs())
+		cout << "Merging the log files matching " << logFiles[0] << " on their timestamps, including new ones; reorder window: "
+		     << reorderWindow.count()/1000.0 << " seconds" << endl;
+
+	if(followEvents && watcher.Available())
+		cout << "Waiting for file change events; maximum interval between checks of the log file: " << pause.count()/1000.0 << " seconds" << endl;
+	else
+		cout << "Interval between checks of the log file: " << pause.count()/1000.0 << " seconds" << endl;
 
 	if(nLatestChars >= 0)
 		cout << "Showing the last " << nLatestChars << " characters of the existing log file." << endl;
@@ -1280,12 +2276,310 @@ int LogViewer::PrintExtraInfo()
 }
 
 
+/// Open the log file again, e.g. after a rotation, and follow it from its beginning
+
+int LogViewer::ReopenLogFile()
+{
+	reader->Close();
+
+	// The new file may be compressed, or no longer
+	reader.reset(LogReader::Create(readerType, logFile));
+	SetUpReader(*reader, true);
+
+	const int r = reader->Open(logFile);
+
+	if(followEvents && readerType != "shm")
+		watcher.Watch(logFile);
+
+	if(r == 0 && useIndex)
+		OpenIndex();
+
+	return r;
+}
+
+
+/// Read the rotated files of the log file, oldest first, as a continuation of each other;
+/// the current file then follows from its beginning
+
+int LogViewer::ReadRotatedLogs(const std::string &_from, std::streamoff _offset)
+{
+	using namespace std;
+
+	vector<string> files = LogReader::RotatedFiles(logFile);
+	string_view line;
+
+	// Only the files from _from on, the first one from _offset
+	const auto from = find(files.begin(), files.end(), _from);
+
+	if(from != files.end())
+		files.erase(files.begin(), from);
+
+	for(const string &file : files)
+	{
+		unique_ptr<LogReader> rotated(LogReader::Create(readerType, file));
+		SetUpReader(*rotated, false);
+
+		if(rotated->Open(file) != 0) {
+			cerr << "logviewer: warning: cannot open the rotated log file: " << file << endl;
+			continue;
+		}
+
+		cout << "--- ROTATED LOG FILE: " << file << " ---" << endl;
+
+		if(file == _from)
+			rotated->Seek(_offset);
+
+		if(printLogFile)
+			logFileField = file;
+
+		if(batch)
+		{
+			BatchScan(*rotated);
+			continue;
+		}
+
+		while(rotated->GetLine(line))
+		{
+			if(line.empty())
+				continue;
+
+			int knownLevel = -1;
+
+			if(rotated->Truncated() > 0) {
+				knownLevel = cutLevel;
+				line = MarkCut(line, rotated->Truncated());
+			}
+
+			if(pipeline.Running()) {
+				pipeline.Push(line, 0, knownLevel);
+			}
+			else {
+				MoveBackToEndLogsBlock();
+				ProcessLine(line, knownLevel);
+			}
+		}
+
+		// The writer thread uses the file name
+		if(pipeline.Running())
+			pipeline.Drain();
+	}
+
+	if(printLogFile)
+		logFileField = logFile;
+
+	if(files.empty() == false) {
+		cout << "--- LOG FILE: " << logFile << " ---" << endl;
+		WriteFooter();
+	}
+
+	return int(files.size());
+}
+
+
+/// Continue from the state saved by the previous run; return 1 if resumed, 0 to start as usual
+
+int LogViewer::ResumeFromCheckpoint()
+{
+	LogCheckpoint::State state;
+
+	// First run
+	if(checkpoint.Load(state) != 0)
+		return 0;
+
+	// The file read at the end of the previous run: the log file, or one of its rotated files,
+	// if it has been rotated meanwhile
+	std::string from;
+
+	if(LogCheckpoint::Matches(state, logFile)) {
+		from = logFile;
+	}
+	else {
+		for(const std::string &file : LogReader::RotatedFiles(logFile)) {
+			if(LogCheckpoint::Matches(state, file)) {
+				from = file;
+				break;
+			}
+		}
+	}
+
+	if(from.empty()) {
+		cerr << "logviewer: warning: the log file has been replaced since its state was saved; --resume will start as a new run." << endl;
+		return 0;
+	}
+
+	logNumber = int(state.logNumber);
+	logLevels.SetPrevLevel(state.prevLevel);
+	distPrevLogContext = state.distPrevLogContext;
+
+	context.Erase();
+	for(const std::pair<int, std::string> &p : state.pastLogs)
+		context.AddPastLog(p.second, p.first);
+
+	if(from == logFile)
+	{
+		reader->Seek(state.offset);
+	}
+	else
+	{
+		// The rest of the old file, and the files rotated after it
+		ReadRotatedLogs(from, state.offset);
+		reader->Seek(0);
+	}
+
+	return 1;
+}
+
+
+/// Save the reading state for the next run (--resume); the logs read must have been processed
+
+int LogViewer::SaveCheckpoint()
+{
+	if(checkpoint.IsOpen() == false || !reader)
+		return 0;
+
+	// The numbering and the context of the logs are kept by the writer thread
+	if(pipeline.Running())
+		pipeline.Drain();
+
+	LogCheckpoint::State state;
+
+	// The open file: the old one, while a rotation is pending
+	state.inode = reader->Inode();
+	state.offset = reader->Tell();
+	state.prefixHash = LogCheckpoint::PrefixHash(*reader, state.offset);
+	state.logNumber = logNumber;
+	state.prevLevel = logLevels.PrevLevel();
+	state.distPrevLogContext = distPrevLogContext;
+	state.pastLogs = context.PastLogs();
+
+	if(checkpoint.Save(state) == LogCheckpoint::err_cannotWrite) {
+		cerr << "logviewer: warning: cannot write the state file; --resume will not be available." << endl;
+		checkpoint.SetFile("");
+		return -1;
+	}
+
+	return 0;
+}
+
+
+/// Load the sidecar index of the log file
+
+int LogViewer::OpenIndex()
+{
+	if(reader && reader->Seekable() == false) {
+		cerr << "logviewer: warning: the index is not available for compressed log files; it will not be used." << endl;
+		useIndex = false;
+		return -1;
+	}
+
+	// The index stores one entry per line
+	if(delimiters != "\n") {
+		cerr << "logviewer: warning: the index is available for line based logs only; it will not be used." << endl;
+		useIndex = false;
+		return -1;
+	}
+
+	// The levels in the index are only valid with the same level detection settings
+	std::stringstream config;
+
+	for(int level = 0; level < 16; ++level)
+		config << level << ":" << logLevels.GetTags(level) << ";";
+
+	config << levelColumn << " " << multiLineLogs << " " << textParsing << " " << warnUnknownLogLevel << " " << levelPosition;
+
+	const std::string configStr = config.str();
+	const std::string indexFile = LogIndex::IndexFileName(logFile, indexDir);
+
+	const int n = index.Open(logFile, indexFile, LogIndex::Hash(configStr.data(), configStr.size()));
+
+	if(verbose)
+		cout << "Index file: " << indexFile << " - " << n << " logs indexed." << endl;
+
+	return n;
+}
+
+
+/// With an index, skip the logs whose level is too low to be shown or to be part of a context
+
+int LogViewer::SkipIndexedLogs(LogReader &_reader)
+{
+	const size_t first = index.Find(_reader.Tell());
+
+	if(first == LogIndex::npos)
+		return 0;
+
+	const int threshold = std::min(minLevel, context.MinContextLevel());
+
+	// A log of unknown level is parsed again, as its level may come from the previous ones
+	size_t i = first;
+	while(i < index.Size() && index[i].Level() >= 0 && index[i].Level() < threshold)
+		++i;
+
+	if(i == first)
+		return 0;
+
+	const int nSkipped = int(i - first);
+
+	logNumber += nSkipped;
+	nIndexSkipped += nSkipped;
+	logLevels.SetPrevLevel(index[i - 1].Level());
+
+	_reader.Seek(i < index.Size() ? index[i].Offset() : index.End());
+
+	return nSkipped;
+}
+
+
+/// Offset of the first of the latest _nLogs logs, from the index if it is up to date
+
+std::streamoff LogViewer::FindLatestLogs(LogReader &_reader, int _nLogs)
+{
+	if(useIndex) {
+		const std::streamoff pos = index.FindLatestLogs(_nLogs, _reader.Size());
+		if(pos >= 0)
+			return pos;
+	}
+
+	return _reader.FindLatestLogs(_nLogs, logDelimiters);
+}
+
+
+/// Move back to print again the latest _nLogs logs (printAll = from the beginning); return the new position
+
+std::streamoff LogViewer::ReloadLogs(int _nLogs)
+{
+	if(merger.NSources() > 0)
+	{
+		// Each file moves back by _nLogs logs; the lines waiting to be merged are read again
+		merger.Discard();
+
+		for(size_t i = 0; i < merger.NSources(); ++i) {
+			if(merger.Dropped(i))
+				continue;
+			LogReader &src = merger.Reader(i);
+			src.Seek(_nLogs == printAll ? 0 : src.FindLatestLogs(_nLogs, logDelimiters));
+		}
+
+		return 0;
+	}
+
+	if(reader->Seek(_nLogs == printAll ? 0 : FindLatestLogs(*reader, _nLogs)) != 0)
+		cerr << "logviewer: warning: the logs already read from this input cannot be read again." << endl;
+
+	return reader->Tell();
+}
+
+
 /// Read the keyboard for real time user interaction
 
-int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
+int LogViewer::ReadKeyboard(std::streamoff &pos)
 {
 	key = rdKb.Get();
 
+	// The commands change the state of the writer thread, or write themselves: wait for it
+	if(key != 0 && pipeline.Running())
+		pipeline.Drain();
+
 	// Pause logs display
 	if(key == 'p' || key == 'P') {
 		cout << "Paused... " << std::flush;
@@ -1293,6 +2587,13 @@ int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
 		cout << "Resumed" << endl;
 	}
 
+	// Activity of the followed files
+	if(key == 's' && merger.NSources() > 0) {
+		size_t hot, cold;
+		merger.Activity(hot, cold);
+		cout << "Files: " << hot + cold << " - hot: " << hot << " - cold (checked less often): " << cold << endl;
+	}
+
 	// Change minimum log level
 	if(key >= '1' && key <= '7') {
 		minLevel = key - char('0');
@@ -1302,8 +2603,7 @@ int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
 	// Reload all logs
 	if(key == 'R') {
 		cout << "--- RELOAD LOG FILE ---" << endl;
-		ifs.seekg(0);
-		pos = ifs.tellg();
+		pos = ReloadLogs(printAll);
 	}
 
 	// Reload last n logs
@@ -1311,18 +2611,7 @@ int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
 		cout << "--- RELOAD LAST " << nLogsReload << " LOGS ---" << endl;
 
 		// Start reading from the last "nLogsReload" logs
-		// Reposition the cursor at the end of the file, and go back counting the new lines
-		ifs.seekg(-1, std::ios::end);
-		int nLogs = 0;
-
-		while(ifs.tellg() > 0)
-		{
-			if(ifs.peek() == '\n') ++nLogs;
-			if(nLogs > nLogsReload) break;
-			ifs.seekg(-1, std::ios::cur);
-		}
-
-		pos = ifs.tellg();
+		pos = ReloadLogs(nLogsReload);
 	}
 
 	// Set the number of logs to reload
@@ -1339,7 +2628,9 @@ int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
 
 	// Exit logviewer
 	if(key == 'q' || key == 'Q') {
+		SaveCheckpoint();
 		cout << endl;
+		ReportLevelSearch();
 		rdKb.~ReadKeyboard();
 		rd->~ResetDefaults();
 		cout << "logviewer stopped.\n" << endl;
@@ -1352,7 +2643,7 @@ int LogViewer::ReadKeyboard(std::ifstream &ifs, std::streamoff &pos)
 
 /// Read commands for real time external control
 
-int LogViewer::ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos)
+int LogViewer::ReadExternalCommands(std::streamoff &pos)
 {
 	using namespace std;
 
@@ -1381,6 +2672,10 @@ int LogViewer::ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos)
 	// Erase the file ASAP
 	remove(cmdFile.c_str());
 
+	// The commands change the state of the writer thread, or write themselves: wait for it
+	if(pipeline.Running())
+		pipeline.Drain();
+
 	/// Execute commands
 	while(cmdQueue.empty() == false)
 	{
@@ -1392,6 +2687,8 @@ int LogViewer::ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos)
 		ss >> cmd_token;
 
 		if(cmd_token == "quit") {
+			SaveCheckpoint();
+			ReportLevelSearch();
 			rdKb.~ReadKeyboard();
 			exit(0);
 		}
@@ -1408,24 +2705,12 @@ int LogViewer::ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos)
 		}
 		else if(cmd_token == "reload_all") {
 			// Reload all logs
-			ifs.seekg(0);
-			pos = ifs.tellg();
+			pos = ReloadLogs(printAll);
 			cout << "Info: log file reloaded." << endl;
 		}
 		else if(cmd_token == "reload") {
 			// Reload last n logs
-			// Reposition the cursor at the end of the file, and go back counting the new lines
-			ifs.seekg(-1, ios::end);
-			int nLogs = 0;
-
-			while(ifs.tellg() > 0)
-			{
-				if(ifs.peek() == '\n') ++nLogs;
-				if(nLogs > nLogsReload) break;
-				ifs.seekg(-1, ios::cur);
-			}
-
-			pos = ifs.tellg();
+			pos = ReloadLogs(nLogsReload);
 		}
 		else if(cmd_token == "reload_n") {
 			// Set the number of logs to reload
@@ -1438,10 +2723,13 @@ int LogViewer::ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos)
 		}
 		else if(cmd_token == "switch_log") {
 			ss >> arg_token;
-			if(arg_token.size() > 0) {
+			if(merger.NSources() > 0) {
+				cerr << "Warning: switch_log is not available with multiple log files." << endl;
+			}
+			else if(arg_token.size() > 0) {
 				logFile = arg_token;
-				inLogFs.close();
-				inLogFs.open(logFile);
+				ReopenLogFile();
+				pos = reader->Tell();
 			}
 		}
 		//+TODO - Add commands here
@@ -14,15 +14,25 @@
 #ifndef LOGVIEWER_HPP
 #define LOGVIEWER_HPP
 
+#include "FileWatcher.hpp"
+#include "LogCheckpoint.hpp"
 #include "LogContext.hpp"
 #include "LogFormatter.hpp"
+#include "LogIndex.hpp"
 #include "logLevels.h"
+#include "LogMerger.hpp"
+#include "LogPipeline.hpp"
+#include "LogReader.hpp"
 #include "progArgs.h"
 #include "ReadKeyboard.h"
+#include "TagScan.hpp"
 
 #include <chrono>
 #include <fstream>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #ifdef _WIN32
 #include <Windows.h>
@@ -43,6 +53,8 @@ struct ResetDefaults;
 
 class LogViewer
 {
+	struct BatchChunk;					// see logviewer_batch.cpp
+
 public:
 	LogViewer();
 	LogViewer(const std::string &_logFile, int _minLogLevel = 0);
@@ -50,6 +62,7 @@ public:
 	~LogViewer();
 
 	int Run();
+	int ExitStatus();					// of the command run by Run(), if any; 0 otherwise
 
 	int SetDefaultValues();
 	int SetLogFileName(const std::string &_logFile);
@@ -78,15 +91,44 @@ private:
 	int ReadCommandLineParams(int argc, char *argv[]);
 	int WriteHeader();
 	int WriteHeader_html();
-	int WriteLog(const std::string &_log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1);
+	int WriteLog(std::string_view _log, int _level, const std::string &_file, char _tag = ' ', int _logNumber = -1);
 	int WriteFooter();
 	int WriteFooter_html();
+	int RunMerge();
+	bool MergeInputs() const;
+	bool LiveInput() const;
+	bool CanPassThrough() const;
+	int RunPassthrough();
+	int RunBatch();
+	int BatchScan(LogReader &_reader);
+	std::streamoff ReadChunk(LogReader &_reader, std::streamoff _offset, std::streamoff _end, BatchChunk &_chunk);
+	void ScanChunk(BatchChunk &_chunk) const;
+	int WatchLogFiles();
+	int ProcessLine(std::string_view _line, int _level = -1, int _floor = -1);
+	void SetUpReader(LogReader &_reader, bool _follow);
+	bool ScanCut(std::string_view _part, size_t _offset);
+	std::string_view MarkCut(std::string_view _line, size_t _truncated);
+	bool NextLog(std::string_view _line, size_t &_pos, std::string_view &_log) const;
+	bool ShowLog(std::string_view _log, int _level, int _passes = -1);
+	bool PassFilters(std::string_view _log) const;
+	void ReportLevelSearch() const;
+	int  StartPipeline();
+	void ParseLine(LogPipeline::Item &_item) const;
+	void WriteLine(LogPipeline::Item &_item);
 	int GenerateLogHeader();
 	int MoveBackToEndLogsBlock();
 	int MoveBackToEndLogsBlock_html();
 	int PrintExtraInfo();
-	int ReadKeyboard(std::ifstream &ifs, std::streamoff &pos);
-	int ReadExternalCommands(std::ifstream &ifs, std::streamoff &pos);
+	int ReopenLogFile();
+	int ReadRotatedLogs(const std::string &_from = "", std::streamoff _offset = 0);
+	int ResumeFromCheckpoint();
+	int SaveCheckpoint();
+	int OpenIndex();
+	int SkipIndexedLogs(LogReader &_reader);
+	std::streamoff FindLatestLogs(LogReader &_reader, int _nLogs);
+	std::streamoff ReloadLogs(int _nLogs);
+	int ReadKeyboard(std::streamoff &pos);
+	int ReadExternalCommands(std::streamoff &pos);
 	int AddHtmlControls();
 
 private:
@@ -96,7 +138,25 @@ private:
 	// Files' details
 
 	std::string   logFile;				// input log file name
-	std::ifstream inLogFs;				// input file stream where the logs come from
+	std::vector<std::string>  logFiles;	// all the input log files (--input can be repeated), or their patterns (--dir)
+	std::string   readerType;			// input reader implementation: stream, mmap, uring, cold, direct, shm, syslog
+	std::unique_ptr<LogReader>  reader;	// where the logs come from
+	std::vector<std::string>  childCommand;	// command run to read its output, instead of a file (after --)
+
+	size_t        maxLineSize;			// longer lines are truncated (default = 0 = no limit)
+	int           cutLevel;				// level found in the part skipped of the last truncated line
+	std::string   cutText;				// end of the part scanned of a truncated line
+	std::string   cutLine;				// a truncated line, with its marker
+
+	LogMerger     merger;				// several log files, merged in time order
+	std::chrono::milliseconds  reorderWindow;	// maximum wait for late logs from the other files (default = 500)
+
+	bool          useIndex;				// keep a sidecar index of the log file (default = false)
+	std::string   indexDir;				// directory of the index files (default = next to the log file)
+	LogIndex      index;
+	int           nIndexSkipped = 0;		// logs skipped with the index
+
+	LogCheckpoint  checkpoint;			// reading state saved for the next run (--resume)
 
 	bool          logToFile;			// (default = false)
 	std::string   outLogFile;			// file name for the output stream to redirect the logs (extensions added by logviewer)
@@ -111,6 +171,8 @@ private:
 	// Logs' details
 
 	std::string   delimiters;			// Specify custom delimiters for the messages (default = new line)
+	ByteSet       logDelimiters;		// delimiters plus new line, to search the logs in the file
+	ByteSet       splitDelimiters;		// to split a line/record in logs: logDelimiters for files, delimiters for live inputs
 
 	std::string   logHeader;
 
@@ -129,8 +191,10 @@ private:
 
 	LogLevels     logLevels;			// custom log levels
 	int           levelColumn;			// ID of the column which contains the log level (default = -1, i.e. dynamic)
+	bool          levelPosition;		// learn where the level usually is, and take the one found there (default = false)
 	int           minLevel;				// minimum level a log must have to be shown
 	int           beepLevel;			// minimum level to get an audio signal (disabled if < 0)
+	int           stderrLevel;			// minimum level of the logs on the command's standard error (disabled if < 0)
 	bool          warnUnknownLogLevel;	// warning for missing level in a log
 
 	// Output details
@@ -150,9 +214,12 @@ private:
 	bool          newLogsOnly;			// only print logs generated from now on
 	int           nLatest;				// number of latest logs to be printed (-1 = all)
 	int           nLatestChars;			// number of latest characters to be printed (-1 = all)
+	bool          readRotated;			// read the rotated files of the log file first, oldest first
 
 	std::vector<std::string>  includeStrings,	// must contain the specified substring
 							  excludeStrings;	// must not contain the specified substring
+	std::vector<TagMatcher>   includeMatchers;	// one per include string
+	TagMatcher                excludeMatcher;	// of all the exclude strings
 	std::string   tempStr;
 	bool          incStrFlag,
 				  excStrFlag;			// flags to decide whether to check for substrings
@@ -161,10 +228,20 @@ private:
 
 	LogContext  context;				// logs belonging to the current context
 
+	// Processing state, shared by all the logs
+
+	std::string   contextLog;			// buffer of a context log
+	int           distPrevLogContext;	// distance of a future log from the current one
+	bool          newLine;				// a new line is needed before the next log
+	int           nPrintedLogs;			// number of printed logs
+
 	// Timing and user interaction
 
 	std::chrono::milliseconds  pause;	// pause among a check of the log file and the next (default = 1000)
 
+	bool          followEvents;			// wait for file change events, with pause as timeout (default = true)
+	FileWatcher   watcher;
+
 	utilities::ReadKeyboard  rdKb;
 	int                      key;
 
@@ -173,6 +250,12 @@ private:
 	std::string  cmdLineParams;			// command line parameters
 
 	ResetDefaults  *rd;
+
+	// Processing threads (declared last, to be stopped first)
+
+	int           nThreads;				// parsing threads (default = 0, i.e. everything on the main thread)
+	bool          batch;				// scan the existing logs on all the cores, then exit (default = false)
+	LogPipeline   pipeline;				// reading, parsing and writing on separate threads
 };
 
 
@@ -0,0 +1,339 @@
+/******************************************************************************
+ * logviewer_batch.cpp
+ *
+ * One-shot scan of an existing log file, on all the cores.
+ *
+ * Copyright (C) 2012-2019 Pietro Mele
+ * Released under a GPL 3 license.
+ *
+ * pietrom16@gmail.com
+ *
+ *****************************************************************************/
+
+
+#include "logviewer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+namespace log_viewer {
+
+
+/** The file is split into chunks ending with a new line, which are scanned
+ *  concurrently: their logs are split, their raw levels found, and the filters
+ *  checked. The chunks are then consumed in the file order on the main thread,
+ *  where the levels inherited by multi-line logs and the context are resolved:
+ *  both cross the chunk borders exactly as in a sequential read.
+ */
+
+struct LogViewer::BatchChunk
+{
+	struct Log
+	{
+		size_t  begin, size;		// position in data
+		int     level;				// raw level, see LogLevels::FindLogLevelRaw()
+		bool    passes;				// result of PassFilters()
+		bool    firstInLine;
+		size_t  cut;				// bytes truncated after the log, at the end of a line longer than maxLineSize
+	};
+
+	// A line truncated while reading the chunk
+	struct Cut
+	{
+		size_t  end;				// of the line, in data
+		size_t  size;				// bytes skipped
+		int     level;				// found in the bytes skipped, see LogViewer::ScanCut()
+	};
+
+	std::vector<char>  data;
+	std::vector<Cut>   cuts;
+	std::vector<Log>   logs;
+};
+
+
+static const size_t batchChunkSize = 4 << 20;
+
+
+int LogViewer::RunBatch()
+{
+	using namespace std;
+
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const streamoff from = reader->Tell();
+
+	BatchScan(*reader);
+
+	WriteFooter();
+
+	SaveCheckpoint();
+
+	// Throughput, the point of scanning with the cold readers
+	const string type = reader->Type();
+
+	if(verbose || type == "cold" || type == "direct")
+	{
+		const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		const double mb = double(reader->Tell() - from) / 1e6;
+
+		stringstream report;
+		report << fixed << setprecision(1) << "Scanned " << mb << " MB in " << setprecision(2) << seconds
+		       << " s: " << setprecision(1) << (seconds > 0.0 ? mb / seconds : 0.0) << " MB/s" << endl;
+		cout << report.str();
+	}
+
+	ReportLevelSearch();
+
+	return 0;
+}
+
+
+/// Scan _reader from its position to its current end; return the number of logs
+
+int LogViewer::BatchScan(LogReader &_reader)
+{
+	using namespace std;
+
+	typedef unique_ptr<BatchChunk>  Chunk;
+
+	const size_t nWorkers = (nThreads > 0) ? size_t(nThreads) : max(1u, thread::hardware_concurrency());
+	const size_t maxChunks = 2 * nWorkers;		// chunks read ahead
+
+	// A sequential input (e.g. a compressed file) ends when it has no more data
+	streamoff        offset = _reader.Tell();
+	const streamoff  end = _reader.Seekable() ? _reader.Size() : numeric_limits<streamoff>::max();
+
+	deque<future<Chunk>>  chunks;
+	bool skipLine = false;
+	int  nLogs = 0;
+
+	while(offset < end || chunks.empty() == false)
+	{
+		// Keep the workers busy
+		while(offset < end && chunks.size() < maxChunks)
+		{
+			Chunk chunk(new BatchChunk);
+			offset = ReadChunk(_reader, offset, end, *chunk);
+
+			if(chunk->data.empty())
+				break;
+
+			chunks.push_back(async(launch::async, [this](Chunk c) { ScanChunk(*c); return c; }, move(chunk)));
+		}
+
+		if(chunks.empty())
+			break;
+
+		const Chunk chunk = chunks.front().get();
+		chunks.pop_front();
+
+		MoveBackToEndLogsBlock();
+
+		for(const BatchChunk::Log &l : chunk->logs)
+		{
+			// A log filtered out skips the rest of its line
+			if(skipLine && l.firstInLine == false)
+				continue;
+
+			std::string_view log(chunk->data.data() + l.begin, l.size);
+
+			if(l.cut > 0)
+				log = MarkCut(log, l.cut);
+
+			++logNumber;
+
+			const int level = logLevels.ResolveLogLevel(l.level, log, levelColumn);
+
+			skipLine = (ShowLog(log, level, l.passes ? 1 : 0) == false);
+		}
+
+		nLogs += int(chunk->logs.size());
+	}
+
+	// Continue after the logs scanned (e.g. --resume at the next run)
+	if(_reader.Seekable())
+		_reader.Seek(offset);
+
+	return nLogs;
+}
+
+
+/// Read the log file from _offset to the last new line within a chunk size
+/// (or to the end of a longer line, truncated beyond maxLineSize); return the offset of the next chunk
+
+std::streamoff LogViewer::ReadChunk(LogReader &_reader, std::streamoff _offset, std::streamoff _end, BatchChunk &_chunk)
+{
+	static const ByteSet newLine("\n");
+
+	std::vector<char> &data = _chunk.data;
+
+	if(_reader.Seekable() == false)
+	{
+		// Whole lines, as they come
+		std::string_view line;
+		data.clear();
+
+		while(data.size() < batchChunkSize)
+		{
+			if(_reader.GetLine(line)) {
+				data.insert(data.end(), line.begin(), line.end());
+
+				if(_reader.Truncated() > 0)
+					_chunk.cuts.push_back(BatchChunk::Cut{ data.size(), _reader.Truncated(), cutLevel });
+
+				data.push_back('\n');
+			}
+			else if(data.empty() && &_reader == reader.get() && _reader.PollFds().empty() == false) {
+				// A pipe is read until it is closed
+				watcher.WatchStreams(_reader.PollFds());
+				watcher.Wait(pause);
+			}
+			else
+				break;
+		}
+
+		return data.empty() ? _end : _reader.Tell();
+	}
+
+	size_t size = batchChunkSize;
+
+	while(true)
+	{
+		size = std::min(size, size_t(_end - _offset));
+
+		const char *block = nullptr;
+		const size_t n = _reader.ReadBlock(_offset, size, block);
+
+		if(n == 0) {
+			data.clear();
+			return _end;
+		}
+
+		if(_offset + std::streamoff(n) >= _end) {
+			data.assign(block, block + n);
+			return _offset + std::streamoff(n);
+		}
+
+		const char *nl = newLine.FindLast(block, block + n);
+
+		if(nl != nullptr) {
+			data.assign(block, nl + 1);
+			return _offset + std::streamoff(nl + 1 - block);
+		}
+
+		if(maxLineSize > 0 && n > maxLineSize)
+		{
+			// A line longer than the maximum: its beginning; the rest is only searched for its end
+			data.assign(block, block + maxLineSize);
+
+			bool scan = ScanCut(std::string_view(block, maxLineSize), 0);
+			size_t skipped = n - maxLineSize;
+
+			if(scan)
+				scan = ScanCut(std::string_view(block + maxLineSize, skipped), maxLineSize);
+
+			std::streamoff next = _offset + std::streamoff(n);
+			const char *end = nullptr;
+
+			while(next < _end && end == nullptr)
+			{
+				const size_t m = _reader.ReadBlock(next, std::min(batchChunkSize, size_t(_end - next)), block);
+
+				if(m == 0)
+					break;
+
+				end = static_cast<const char*>(std::memchr(block, '\n', m));
+
+				const size_t len = (end != nullptr) ? size_t(end - block) : m;
+
+				if(scan)
+					scan = ScanCut(std::string_view(block, len), maxLineSize + skipped);
+
+				skipped += len;
+				next += std::streamoff(len + (end != nullptr ? 1 : 0));
+			}
+
+			_chunk.cuts.push_back(BatchChunk::Cut{ maxLineSize, skipped, cutLevel });
+			data.push_back('\n');
+
+			return next;
+		}
+
+		size *= 2;		// a line longer than a chunk
+	}
+}
+
+
+/// On a worker thread: split the lines of a chunk into logs, find their raw levels, check the filters
+
+void LogViewer::ScanChunk(BatchChunk &_chunk) const
+{
+	const char *begin = _chunk.data.data();
+	const char *end = begin + _chunk.data.size();
+	const bool filters = incStrFlag || excStrFlag || compare.empty() == false;
+
+	std::string_view text;
+	size_t nextCut = 0;
+
+	for(const char *p = begin; p < end; )
+	{
+		const char *nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+		std::string_view line(p, size_t((nl != nullptr ? nl : end) - p));
+
+		p = (nl != nullptr) ? nl + 1 : end;
+
+		// Empty lines are skipped, as when following the file
+		if(line.empty())
+			continue;
+
+		// Lines longer than the maximum are truncated; the level of their last log may be in the rest
+		size_t cut = 0;
+		int    restLevel = -1;
+
+		if(nextCut < _chunk.cuts.size() && _chunk.cuts[nextCut].end == size_t(line.data() + line.size() - begin)) {
+			cut = _chunk.cuts[nextCut].size;
+			restLevel = _chunk.cuts[nextCut].level;
+			++nextCut;
+		}
+		else if(maxLineSize > 0 && line.size() > maxLineSize) {
+			cut = line.size() - maxLineSize;
+			if(levelColumn < 0)
+				restLevel = logLevels.FindLogLevelRaw(line.substr(maxLineSize), !textParsing, levelColumn);
+			line = line.substr(0, maxLineSize);
+		}
+
+		size_t pos = 0;
+
+		for(bool first = true; pos != std::string::npos; first = false)
+		{
+			const size_t logBegin = pos;
+			NextLog(line, pos, text);
+
+			BatchChunk::Log l;
+			l.begin = size_t(line.data() - begin) + logBegin;
+			l.size = text.size();
+			l.level = logLevels.FindLogLevelRaw(text, !textParsing, levelColumn);
+			l.passes = filters ? PassFilters(text) : true;
+			l.firstInLine = first;
+			l.cut = 0;
+
+			if(pos == std::string::npos && cut > 0) {
+				l.cut = cut;
+				if(l.level < 0)
+					l.level = restLevel;
+			}
+
+			_chunk.logs.push_back(l);
+		}
+	}
+}
+
+
+} // log_viewer
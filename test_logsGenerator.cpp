@@ -4,6 +4,8 @@
  * Test application to generate random logs.
  * The number of logs can be specified.
  * If no parameter is passed, it generates an 'infinite' number of logs.
+ * With --shm name, the logs are written to a shared memory ring instead of
+ * a file (logviewer --shm name): a reference producer for ShmLogRing.hpp.
  *
  * Copyright (C) 2012-2016 Pietro Mele
  * Released under a GPL 3 license.
@@ -12,6 +14,8 @@
  *
  *****************************************************************************/
 
+#include "ShmLogRing.hpp"
+
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
@@ -32,12 +36,21 @@ int main(int argc, char* argv[])
 	int  nLogs = 10;
 	int  pauseSec = 0;
 
-	if(argc > 1) {
+	// Leading option: the name of the shared memory ring to write to
+	std::string shmName;
+	int a = 1;		// first positional argument
+
+	if(argc > 2 && std::string(argv[1]) == "--shm") {
+		shmName = argv[2];
+		a = 3;
+	}
+
+	if(argc > a) {
 
-		const std::string arg(argv[1]);
+		const std::string arg(argv[a]);
 
 		if(arg == "-h" || arg == "--help") {
-			std::cout << argv[0] << " [nLogs] [distribution] [pause]\n"
+			std::cout << argv[0] << " [--shm name] [nLogs] [distribution] [pause]\n"
 					  << "distribution values:\n"
 					  << "  0. Random"
 					  << "  1. Increasing"
@@ -47,23 +60,40 @@ int main(int argc, char* argv[])
 			exit(0);
 		}
 
-		nLogs = atoi(argv[1]);
+		nLogs = atoi(argv[a]);
 		endless = false;
 	}
 
-	if(argc > 2) {
-		gen = atoi(argv[2]);
+	if(argc > a + 1) {
+		gen = atoi(argv[a + 1]);
 		if(gen >= nGen)
 			gen = 0;
 	}
 
-	if(argc > 3) {
-		pauseSec = atoi(argv[3]);
+	if(argc > a + 2) {
+		pauseSec = atoi(argv[a + 2]);
+	}
+
+	std::string log, line;
+	std::string logFile = shmName.empty() ? "test.log" : "shared memory ring " + shmName;
+	std::ofstream ofs;
+
+#ifdef SHM_LOG_RING_POSIX
+	log_viewer::ShmLogWriter shm;
+
+	if(shmName.empty() == false && shm.Create(shmName) != 0) {
+		std::cerr << "Cannot create the shared memory ring: " << shmName << std::endl;
+		return 1;
 	}
+#else
+	if(shmName.empty() == false) {
+		std::cerr << "Shared memory rings are not available on this platform." << std::endl;
+		return 1;
+	}
+#endif
 
-	std::string log;
-	std::string logFile = "test.log";
-	std::ofstream ofs(logFile);
+	if(shmName.empty())
+		ofs.open(logFile);
 
 	// Log levels (a custom levels enum can be used)
 	static const int nLogLevels = 8;
@@ -105,16 +135,26 @@ int main(int argc, char* argv[])
 		int format = rand() % 3;
 		switch (format) {
 			case 0:
-				ofs << LogTime() << LogDate() << logLevelTags[level] << " " << log << std::endl;
+				line = LogTime() + LogDate() + logLevelTags[level] + " " + log;
 				break;
 			case 1:
-				ofs << LogDate() << logLevelTags[level] << LogTime() << " " << log << std::endl;
+				line = LogDate() + logLevelTags[level] + LogTime() + " " + log;
 				break;
 			case 2:
-				ofs << logLevelTags[level] << LogTime() << LogDate() << " " << log << std::endl;
+				line = logLevelTags[level] + LogTime() + LogDate() + " " + log;
 				break;
 		}
 
+#ifdef SHM_LOG_RING_POSIX
+		if(shmName.empty() == false) {
+			// The level and the time travel with the log: logviewer does not parse them
+			const auto now = std::chrono::system_clock::now().time_since_epoch();
+			shm.Write(line, level, std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+		}
+		else
+#endif
+			ofs << line << std::endl;
+
 		std::cout << "." << std::flush;
 
 		std::this_thread::sleep_for(pause);
@@ -122,7 +162,12 @@ int main(int argc, char* argv[])
 		++i;
 	}
 
-	std::cout << "\n" << i << " test logs generated in file: " << logFile << std::endl;
+	std::cout << "\n" << i << " test logs generated in " << (shmName.empty() ? "file: " : "") << logFile << std::endl;
+
+#ifdef SHM_LOG_RING_POSIX
+	if(shm.Dropped() > 0)
+		std::cout << shm.Dropped() << " logs dropped: the shared memory ring was full." << std::endl;
+#endif
 
 	return 0;
 }